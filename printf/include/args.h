@@ -0,0 +1,69 @@
+// License GPL-2.0
+// Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+//
+// Unless required by applicable law or agreed to in writing, this software
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.
+
+#ifndef ARGS_H
+#define ARGS_H
+
+#include <printf.h>
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// max number of pieces in a format string printf_args_format_batch parses once for all its records (longer
+// format strings are parsed for each record)
+#ifndef PRINTF_BATCH_OPS
+#define PRINTF_BATCH_OPS 32
+#endif
+
+// types of printf_arg
+#define PRINTF_ARG_INT32 0 // value.i
+#define PRINTF_ARG_INT64 1 // value.i
+#define PRINTF_ARG_UINT32 2 // value.u
+#define PRINTF_ARG_UINT64 3 // value.u
+#define PRINTF_ARG_DOUBLE 4 // value.d
+#define PRINTF_ARG_STRING 5 // value.s
+
+/*
+ * Tagged argument arrays, for calling the formatter without a va_list (from RPC or scripting layers, or to
+ * format many records with the same format string)
+ * Each argument is checked against its format specifier with the same rules as the C++ front end:
+ * %d -> PRINTF_ARG_INT32 (%ld also PRINTF_ARG_INT64)
+ * %u, %b, %o, %h -> PRINTF_ARG_UINT32 (%l also PRINTF_ARG_UINT64)
+ * %f, %e -> PRINTF_ARG_DOUBLE
+ * %s -> PRINTF_ARG_STRING (not NULL)
+ * %c, * width, .* precision -> PRINTF_ARG_INT32 or PRINTF_ARG_UINT32
+ * An argument of the wrong type, or a missing one, prints '?' in place of its field (a * width or .* precision
+ * of the wrong type is ignored)
+*/
+typedef struct printf_arg
+{
+    uint8_t type;
+    printf_value value;
+} printf_arg;
+
+// tagged argument of each type (C compound literals)
+#define PRINTF_INT32(v) ((printf_arg){.type = PRINTF_ARG_INT32, .value.i = (int32_t)(v)})
+#define PRINTF_INT64(v) ((printf_arg){.type = PRINTF_ARG_INT64, .value.i = (int64_t)(v)})
+#define PRINTF_UINT32(v) ((printf_arg){.type = PRINTF_ARG_UINT32, .value.u = (uint32_t)(v)})
+#define PRINTF_UINT64(v) ((printf_arg){.type = PRINTF_ARG_UINT64, .value.u = (uint64_t)(v)})
+#define PRINTF_DOUBLE(v) ((printf_arg){.type = PRINTF_ARG_DOUBLE, .value.d = (double)(v)})
+#define PRINTF_STRING(v) ((printf_arg){.type = PRINTF_ARG_STRING, .value.s = (v)})
+
+int printf_args_format(printf_ctx* ctx, const char* str, const printf_arg* args, int num_args);
+int printf_args_format_compiled(printf_ctx* ctx, const printf_op* ops, int num_ops, const printf_arg* args,
+    int num_args);
+int printf_args_format_batch(printf_ctx* ctx, const char* str, const printf_arg* args, int args_per_record,
+    int num_records);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,55 @@
+// License GPL-2.0
+// Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+//
+// Unless required by applicable law or agreed to in writing, this software
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.
+
+#ifndef ASPRINTF_H
+#define ASPRINTF_H
+
+#include <printf.h>
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Allocator the asprintf functions take their strings from
+ * alloc -> returns size bytes (with no alignment needed) or NULL if there is no room, data is passed to it as is
+ * A NULL printf_allocator uses malloc, so the string is freed with free
+*/
+typedef struct printf_allocator
+{
+    void* (*alloc)(void* data, size_t size);
+    void* data;
+} printf_allocator;
+
+/*
+ * Bump allocator over a block of memory, for strings freed all at once by printf_arena_reset
+ * memory, size -> the block
+ * used -> bytes of it handed out so far
+*/
+typedef struct printf_arena
+{
+    char* memory;
+    size_t size;
+    size_t used;
+} printf_arena;
+
+void printf_arena_init(printf_arena* arena, char* memory, size_t size);
+void* printf_arena_alloc(void* data, size_t size);
+void printf_arena_reset(printf_arena* arena);
+printf_allocator printf_arena_allocator(printf_arena* arena);
+
+int yaos_vasprintf(const printf_allocator* allocator, char** out, const char* str, va_list arg_list);
+int yaos_asprintf(const printf_allocator* allocator, char** out, const char* str, ...);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
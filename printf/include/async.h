@@ -0,0 +1,102 @@
+// License GPL-2.0
+// Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+//
+// Unless required by applicable law or agreed to in writing, this software
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.
+
+#ifndef ASYNC_H
+#define ASYNC_H
+
+#include <printf.h>
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// max number of bytes in a single message sent through a printf_async (longer messages are cut short)
+#ifndef PRINTF_ASYNC_MAX_MESSAGE
+#define PRINTF_ASYNC_MAX_MESSAGE 256
+#endif
+
+// max number of buffers a printf_async can use
+#ifndef PRINTF_ASYNC_MAX_BUFFERS
+#define PRINTF_ASYNC_MAX_BUFFERS 8
+#endif
+
+// what a printf_async does with a message when every buffer is full
+#define PRINTF_ASYNC_BLOCK 0 // wait for the flusher to write a buffer
+#define PRINTF_ASYNC_DROP_NEWEST 1 // drop the message
+#define PRINTF_ASYNC_DROP_OLDEST 2 // drop the oldest buffer waiting to be written (or the message if there is none)
+
+/*
+ * Asynchronous output to a file descriptor through 2 or more buffers
+ * Producers format each message on their own stack and copy it whole into the buffer being filled, while a
+ * background flusher (printf_async_start) writes the buffers handed to it, so a slow terminal or disk only holds
+ * up the producers once every buffer is full, and then as policy says
+ * The buffer being filled is handed to the flusher when the next message doesn't fit, or earlier by a flush
+ * trigger if there is a free buffer to fill next:
+ * flush_size -> once it holds this many bytes (buffer_size by default)
+ * flush_newline -> 1 to hand it over after each message with a newline in it
+ * flush_ms -> when the flusher has been idle this many milliseconds (0 for never)
+ * The settings can be changed after printf_async_init and before printf_async_start
+ *
+ * memory -> num_buffers buffers of buffer_size bytes one after the other
+ * lengths, messages -> bytes and messages in each buffer
+ * queue, queue_start, queue_count -> buffers waiting for the flusher, oldest first
+ * free, free_count -> buffers which are empty and not the one being filled
+ * fill -> buffer being filled
+ * policy -> what to do when every buffer is full (PRINTF_ASYNC_BLOCK by default)
+ * sig_figs -> significant figures %f and %e print to with no precision (as for a printf_ctx)
+ * dropped -> number of messages dropped
+ * writes -> number of write calls made
+ * error -> errno of the last failed write, or 0
+ * writing -> 1 while the flusher is writing a buffer
+*/
+typedef struct printf_async
+{
+    int fd;
+    char* memory;
+    int num_buffers;
+    int buffer_size;
+    int lengths[PRINTF_ASYNC_MAX_BUFFERS];
+    int messages[PRINTF_ASYNC_MAX_BUFFERS];
+    int queue[PRINTF_ASYNC_MAX_BUFFERS];
+    int queue_start;
+    int queue_count;
+    int free[PRINTF_ASYNC_MAX_BUFFERS];
+    int free_count;
+    int fill;
+    int flush_size;
+    int flush_newline;
+    int flush_ms;
+    int policy;
+    int sig_figs;
+    uint64_t dropped;
+    uint64_t writes;
+    int error;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t room;
+    pthread_t thread;
+    int running;
+    int writing;
+} printf_async;
+
+void printf_async_init(printf_async* async, int fd, char* memory, int num_buffers, int buffer_size);
+int printf_async_vformat(printf_async* async, const char* str, va_list arg_list);
+int printf_async_format(printf_async* async, const char* str, ...);
+int printf_async_flush(printf_async* async);
+int printf_async_start(printf_async* async);
+void printf_async_stop(printf_async* async);
+void printf_async_destroy(printf_async* async);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,66 @@
+// License GPL-2.0
+// Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+//
+// Unless required by applicable law or agreed to in writing, this software
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.
+
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#include <printf.h>
+
+#include <stdarg.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Deferred (binary) logging
+ * Instead of formatting, printf_log_record stores the format string pointer and the raw bits of each argument
+ * in a record so the formatting can be done later by printf_log_replay on a low priority thread
+ *
+ * Record layout (native byte order, no padding):
+ * uint16_t length of the whole record in bytes
+ * const char* format string
+ * one field per format specifier argument:
+ *  %d %u %b %o %h -> 4 bytes (8 bytes with l)
+ *  %f %e -> 8 bytes holding the bits of the double
+ *  %c -> 1 byte
+ *  %s -> uint16_t string length followed by the string bytes and a 0 terminator
+ * a * width is 4 bytes holding the int width in front of the field of its specifier
+ * a .* precision is 4 bytes holding the int precision after any * width
+ * %s with a precision only stores the bytes it prints, with a 0 terminator added
+ *
+ * The format string is only referenced by its pointer so it must be a string literal (or otherwise live and
+ * unchanged until the record is replayed)
+ *
+ * buffer, size, index -> where records are written and how much has been used
+ * dropped -> number of records which didn't fit and were discarded
+ * cache -> optional cache of compiled format strings so recording doesn't parse the format string
+*/
+typedef struct printf_log
+{
+    uint8_t* buffer;
+    int size;
+    int index;
+    uint32_t dropped;
+    printf_cache* cache;
+} printf_log;
+
+// max length of a single record
+#define PRINTF_LOG_MAX_RECORD 0xffff
+
+void printf_log_init(printf_log* log, uint8_t* buffer, int size);
+void printf_log_reset(printf_log* log);
+int printf_log_vrecord(printf_log* log, const char* format, va_list arg_list);
+int printf_log_record(printf_log* log, const char* format, ...);
+int printf_log_replay(const uint8_t* records, int len, printf_ctx* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,65 @@
+// License GPL-2.0
+// Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+//
+// Unless required by applicable law or agreed to in writing, this software
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.
+
+#ifndef IOV_H
+#define IOV_H
+
+#include <printf.h>
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// spans of the format string or a %s argument shorter than this are copied into the arena rather than given
+// their own entry, as an entry costs the kernel more than copying a few bytes
+#ifndef PRINTF_IOV_COPY_MIN
+#define PRINTF_IOV_COPY_MIN 32
+#endif
+
+/*
+ * Scatter-gather (writev) output to a file descriptor
+ * Text of the format string and %s arguments are referenced where they are rather than copied (through the
+ * sink's put_ref), while converted values, padding and short spans are written to the arena
+ * printf_iov_format sends the whole message with a single writev unless it runs out of entries or arena first
+ *
+ * ctx -> the context formatting into the entries (set its sig_figs or cache as for any context)
+ *        yaos_format(&iov->ctx, ...) can put several messages in one writev, but then the strings they
+ *        reference must stay valid until printf_iov_flush
+ * fd -> file descriptor written to
+ * entries, max_entries, count -> iovec entries of the message so far (max_entries is cut down to IOV_MAX)
+ * arena, arena_size, arena_used -> bytes of the message which are copied (arena_size must be at least 1)
+ * writes -> number of writev calls made
+ * error -> errno of a failed write since the start of the last printf_iov_format, or 0
+*/
+typedef struct printf_iov
+{
+    printf_ctx ctx;
+    int fd;
+    struct iovec* entries;
+    int max_entries;
+    int count;
+    char* arena;
+    int arena_size;
+    int arena_used;
+    uint64_t writes;
+    int error;
+} printf_iov;
+
+void printf_iov_init(printf_iov* iov, int fd, struct iovec* entries, int max_entries, char* arena, int arena_size);
+int printf_iov_vformat(printf_iov* iov, const char* str, va_list arg_list);
+int printf_iov_format(printf_iov* iov, const char* str, ...);
+int printf_iov_flush(printf_iov* iov);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
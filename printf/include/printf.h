@@ -8,11 +8,308 @@
 #ifndef PRINTF_H
 #define PRINTF_H
 
+#include <stdarg.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// sig_figs value for printing floats with the shortest digits which round trip
+#define PRINTF_SHORTEST 0
+
+// default number of significant figures floats are printed to when no precision is given
+#ifndef PRINTF_SIG_FIGS
+#define PRINTF_SIG_FIGS 5
+#endif
+
+// largest precision a format specifier can give (larger precisions are cut down to it)
+#ifndef PRINTF_MAX_PRECISION
+#define PRINTF_MAX_PRECISION 0x7fff
+#endif
+
+// largest field width a format specifier (or * argument) can give (larger widths are cut down to it)
+#ifndef PRINTF_MAX_WIDTH
+#define PRINTF_MAX_WIDTH 0x7fff
+#endif
+
+// engines converting a double to its shortest decimal digits, which give the same digits
+#define PRINTF_ENGINE_RYU 0
+#define PRINTF_ENGINE_SCHUBFACH 1
+
+// engine used for %f and %e with no precision
+#ifndef PRINTF_FLOAT_ENGINE
+#define PRINTF_FLOAT_ENGINE PRINTF_ENGINE_RYU
+#endif
+
+// max number of chars written by each of the to_chars functions
+#define PRINTF_INT_CHARS 20
+#define PRINTF_BIN_CHARS 66
+#define PRINTF_OCT_CHARS 24
+#define PRINTF_HEX_CHARS 18
+// (a minus sign, "0.", then at most 323 zeros before up to 17 significant figures)
+#define PRINTF_FLOAT_CHARS 343
+#define PRINTF_FLOAT_SCIENTIFIC_CHARS 24
+
+// number of format strings held by a printf_cache
+#ifndef PRINTF_CACHE_SLOTS
+#define PRINTF_CACHE_SLOTS 64
+#endif
+
+// max number of pieces a format string can have to be held by a printf_cache
+#ifndef PRINTF_CACHE_OPS
+#define PRINTF_CACHE_OPS 16
+#endif
+
+// number of buckets in the latency histogram of a printf_stats
+#ifndef PRINTF_STATS_BUCKETS
+#define PRINTF_STATS_BUCKETS 32
+#endif
+
+// conversions counted by a printf_stats, in the order of its conv_calls and conv_chars
+#define PRINTF_STATS_CONVS "sdubohfec"
+#define PRINTF_STATS_NUM_CONVS 9
+
+/*
+ * Output sink printf writes to
+ * put_chars -> outputs a run of len ascii chars from str (or valid UTF-8 bytes for a context with utf8 set)
+ * put_code -> outputs a single unicode char
+ * put_fill -> outputs the ascii char c count times
+ * put_ref -> optional, outputs len bytes like put_chars but from memory which stays valid until the end of the
+ *            format call (the format string's text and %s arguments), so the sink can keep a reference to them
+ *            rather than copying them. NULL to send these through put_chars
+ * data is passed as the first argument to each function for holding the sink's state
+*/
+typedef struct printf_sink
+{
+    void (*put_chars)(void* data, const char* str, int len);
+    void (*put_code)(void* data, int code);
+    void (*put_fill)(void* data, char c, int count);
+    void (*put_ref)(void* data, const char* str, int len);
+    void* data;
+} printf_sink;
+
+// flags of a printf_spec
+#define PRINTF_FLAG_LEFT 1 // '-' -> pad on the right so the field is left aligned
+#define PRINTF_FLAG_ZERO 2 // '0' -> pad numbers with zeros after the sign or base prefix rather than spaces
+
+// width of a printf_spec whose width is given by a * argument
+#define PRINTF_WIDTH_ARG -1
+
+// precision of a printf_spec whose precision is given by a .* argument
+#define PRINTF_PREC_ARG -2
+
+/*
+ * A parsed format specifier
+ * conv -> conversion char (one of s c d u b o h f e) or 0 if the specifier is invalid
+ * l -> 1 if the l length specifier was given
+ * prec -> digits after the decimal point for %.Nf and %.Ne, max bytes of the string for %.Ns, -1 if no precision
+ *         was given or PRINTF_PREC_ARG for .*
+ * flags -> PRINTF_FLAG_* bits
+ * width -> min number of chars printed (0 for no padding) or PRINTF_WIDTH_ARG for *
+*/
+typedef struct printf_spec
+{
+    char conv;
+    char l;
+    int16_t prec;
+    char flags;
+    int16_t width;
+} printf_spec;
+
+// types of printf_op
+#define PRINTF_OP_TEXT 0 // run of len ascii chars at str
+#define PRINTF_OP_CODE 1 // single unicode char held in len
+#define PRINTF_OP_CONV 2 // format specifier spec
+
+/*
+ * A piece of a compiled format string
+*/
+typedef struct printf_op
+{
+    uint8_t type;
+    printf_spec spec;
+    int len;
+    const char* str;
+} printf_op;
+
+/*
+ * An argument for a format specifier
+ * i -> %d and %c, u -> %u %b %o %h, d -> %f %e, s -> %s
+*/
+typedef union printf_value
+{
+    int64_t i;
+    uint64_t u;
+    double d;
+    const char* s;
+} printf_value;
+
+/*
+ * A compiled format string held by a printf_cache
+*/
+typedef struct printf_cache_entry
+{
+    const char* format;
+    int num_ops;
+    printf_op ops[PRINTF_CACHE_OPS];
+} printf_cache_entry;
+
+/*
+ * Cache of compiled format strings keyed on the format string pointer
+ * Format strings must not change while they are in the cache (which is the case for string literals)
+ * hits -> lookups which found the format string already compiled
+ * misses -> lookups which had to compile the format string
+ * uncached -> lookups of format strings with too many pieces to be held (these are parsed as normal)
+ * Not thread safe so use one per thread or lock around its use
+*/
+typedef struct printf_cache
+{
+    printf_cache_entry entries[PRINTF_CACHE_SLOTS];
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t uncached;
+} printf_cache;
+
+/*
+ * Runtime statistics of a formatting context, for sizing buffers and finding expensive log sites
+ * Only gathered while ctx->stats points at one, and not thread safe so use one per context
+ * calls, chars -> calls to yaos_vformat and yaos_vformat_compiled (which printf, snprintf and the cache go
+ *                 through) and the chars they printed
+ * conv_calls, conv_chars -> values formatted and the chars they printed for each conversion in PRINTF_STATS_CONVS
+ * truncated -> chars (or bytes of a UTF-8 buffer) dropped because the context's buffer was full
+ * invalid_utf8 -> invalid UTF-8 bytes printed as '?', in the format string or a %s argument
+ * latency -> histogram of the ticks each call took, bucket i counting calls of 2^(i - 1) to 2^i - 1 ticks
+ *            (the last bucket also counts anything longer)
+ *            ticks are the cycle counter on x86 and the virtual timer on arm64, or else nanoseconds
+*/
+typedef struct printf_stats
+{
+    uint64_t calls;
+    uint64_t chars;
+    uint64_t conv_calls[PRINTF_STATS_NUM_CONVS];
+    uint64_t conv_chars[PRINTF_STATS_NUM_CONVS];
+    uint64_t truncated;
+    uint64_t invalid_utf8;
+    uint64_t latency[PRINTF_STATS_BUCKETS];
+} printf_stats;
+
+/*
+ * Formatting context
+ * Holds everything a single call to the formatter writes to so separate contexts can be used in parallel
+ * sink -> where the output goes
+ * buffer, buffer_size, buffer_index -> destination and cursor when writing to a unicode char buffer
+ * utf8_buffer -> destination when writing to a UTF-8 byte buffer (buffer_size and buffer_index are then in bytes)
+ * utf8_length -> bytes of output given to a UTF-8 buffer, including those which didn't fit
+ * utf8 -> 1 if the sink takes UTF-8 bytes, so valid UTF-8 in strings and the format string is passed to put_chars
+ *         as it is (invalid bytes become '?') rather than decoded for put_code, which the sink must encode
+ * cache -> optional cache of compiled format strings (NULL to parse the format string every call)
+ * stats -> optional statistics gathered for each call (NULL for none)
+ * sig_figs -> significant figures %f and %e print to with no precision (PRINTF_SHORTEST for the shortest round
+ *             trip digits), set to PRINTF_SIG_FIGS by the init functions and can be changed between calls
+*/
+typedef struct printf_ctx
+{
+    printf_sink sink;
+    int* buffer;
+    char* utf8_buffer;
+    int buffer_size;
+    int buffer_index;
+    int utf8_length;
+    int utf8;
+    printf_cache* cache;
+    printf_stats* stats;
+    int sig_figs;
+} printf_ctx;
+
+void printf_ctx_init_buffer(printf_ctx* ctx, int* buffer, int size);
+void printf_ctx_init_utf8_buffer(printf_ctx* ctx, char* buffer, int size);
+void printf_ctx_init_sink(printf_ctx* ctx, const printf_sink* sink);
+
+int yaos_vformat(printf_ctx* ctx, const char* str, va_list arg_list);
+int yaos_format(printf_ctx* ctx, const char* str, ...);
+int yaos_vsnprintf(int* buffer, int size, const char* str, va_list arg_list);
+int yaos_snprintf(int* buffer, int size, const char* str, ...);
+int yaos_vsnprintf_utf8(char* buffer, int size, const char* str, va_list arg_list);
+int yaos_snprintf_utf8(char* buffer, int size, const char* str, ...);
+int yaos_vmeasure(const char* str, va_list arg_list);
+int yaos_measure(const char* str, ...);
+int yaos_vprintf(const char* str, va_list arg_list);
+
+int yaos_compile(const char* str, printf_op* ops, int max_ops);
+int yaos_vformat_compiled(printf_ctx* ctx, const printf_op* ops, int num_ops, va_list arg_list);
+int yaos_format_compiled(printf_ctx* ctx, const printf_op* ops, int num_ops, ...);
+void printf_cache_init(printf_cache* cache);
+const printf_cache_entry* printf_cache_lookup(printf_cache* cache, const char* str);
+void printf_stats_init(printf_stats* stats);
+uint64_t printf_stats_conv_calls(const printf_stats* stats, char conv);
+uint64_t printf_stats_conv_chars(const printf_stats* stats, char conv);
+uint64_t printf_stats_latency(const printf_stats* stats, int percent);
+int printf_stats_print(printf_ctx* ctx, const printf_stats* stats);
+int yaos_parse_op(const char* str, printf_op* op);
+printf_value yaos_read_arg(const printf_spec* spec, va_list* args);
+void yaos_set_width(printf_spec* spec, int width);
+void yaos_set_prec(printf_spec* spec, int prec);
+int yaos_format_value(printf_ctx* ctx, const printf_spec* spec, printf_value value);
+int yaos_format_float32(printf_ctx* ctx, const printf_spec* spec, float val);
+int yaos_format_string(printf_ctx* ctx, const printf_spec* spec, const char* s, int len);
+
 #ifdef TEST
 int my_printf(const char* str, ...);
 #else
 int printf(const char* str, ...);
 #endif
 void set_buffer(int* stdout_buffer, int size);
+// sets the sink printf writes to (NULL restores the stdout sink)
+void set_sink(const printf_sink* new_sink);
+// sets the format string cache printf uses (NULL for none)
+void set_cache(printf_cache* cache);
+// sets the statistics printf gathers (NULL for none)
+void set_stats(printf_stats* stats);
+// sets the significant figures printf prints floats to (PRINTF_SHORTEST for the shortest round trip digits)
+void set_sig_figs(int sig_figs);
+// returns the context printf uses
+printf_ctx* get_stdout_ctx(void);
+
+/*
+ * Output and conversion functions used by the formatter
+ * Each print function returns the number of characters printed
+*/
+void put_char(printf_ctx* ctx, int c);
+void put_chars(printf_ctx* ctx, const char* str, int len);
+void put_ref(printf_ctx* ctx, const char* str, int len);
+void put_fill(printf_ctx* ctx, char c, int count);
+int int_to_chars(char* buffer, int size, int64_t val);
+int unsigned_to_chars(char* buffer, int size, uint64_t val);
+int bin_to_chars(char* buffer, int size, uint64_t val);
+int oct_to_chars(char* buffer, int size, uint64_t val);
+int hex_to_chars(char* buffer, int size, uint64_t val);
+int float_to_chars(char* buffer, int size, double val, int sig_figs);
+int float_scientific_to_chars(char* buffer, int size, double val, int sig_figs);
+int print_int(printf_ctx* ctx, int64_t val);
+int print_unsigned_int(printf_ctx* ctx, uint64_t val);
+int print_bin(printf_ctx* ctx, uint64_t val);
+int print_oct(printf_ctx* ctx, uint64_t val);
+int print_hex(printf_ctx* ctx, uint64_t val);
+int print_float(printf_ctx* ctx, double val);
+int print_float_scientific(printf_ctx* ctx, double val);
+int print_float32(printf_ctx* ctx, float val);
+int print_float32_scientific(printf_ctx* ctx, float val);
+int print_float_prec(printf_ctx* ctx, double val, int prec);
+int print_float_scientific_prec(printf_ctx* ctx, double val, int prec);
+int print_string(printf_ctx* ctx, const char* s);
+int print_string_n(printf_ctx* ctx, const char* s, int len);
+int print_char(printf_ctx* ctx, char c);
+
+/*
+ * UTF-8 helpers, for sinks which take unicode chars but write UTF-8
+*/
+int decode_char(const char* str, int* code);
+int encode_char(int code, char* str);
+int valid_utf8_length(const char* str, int len, int* chars);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
@@ -0,0 +1,602 @@
+// License GPL-2.0
+// Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+//
+// Unless required by applicable law or agreed to in writing, this software
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.
+
+#ifndef PRINTF_HPP
+#define PRINTF_HPP
+
+/*
+ * Type safe C++ (C++20) front end for printf
+ *
+ * yaos::print<"x = %d, y = %lh\n">(ctx, x, y);
+ * yaos::print<"%f\n">(val); // prints with the context printf uses
+ *
+ * The format string is parsed at compile time with the same rules as printf and each argument is checked
+ * against its format specifier, so a mismatch (such as %d with an int64_t) is a compile error
+ * The arguments are passed straight to the conversion functions with no runtime parsing or va_arg
+ *
+ * Accepted argument types:
+ * %d -> signed integer of up to 32 bits (%ld up to 64 bits)
+ * %u, %b, %o, %h -> unsigned integer of up to 32 bits (%l up to 64 bits)
+ * %f, %e -> float or double (%.Nf and %.Ne with a precision)
+ *           a float with no precision is printed with print_float32, so gets the shortest digits of the float
+ *           rather than of it widened to a double (0.1f prints as 0.1 like printf would print 0.1)
+ * %s -> anything which converts to const char* (printed up to its NUL) or to std::string_view (printed with
+ *       its length, so it needn't have a NUL after it and a NUL within it is printed)
+ *       %.Ns prints at most N bytes of either
+ * %c -> char, signed char or unsigned char
+ * * -> a * width takes an integer of up to 32 bits before the argument of its specifier
+ * .* -> a .* precision takes an integer of up to 32 bits after any * width, before the argument
+ *
+ * Specifiers with flags, a width or a .* precision are printed through yaos_format_value (or
+ * yaos_format_float32 for floats and yaos_format_string for string views)
+*/
+
+#include <printf.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace yaos
+{
+    /*
+     * Holds a string literal so it can be given as a template argument
+    */
+    template<std::size_t N>
+    struct format_string
+    {
+        char str[N];
+
+        constexpr format_string(const char (&s)[N])
+        {
+            for(std::size_t i = 0; i < N; i++)
+            {
+                str[i] = s[i];
+            }
+        }
+    };
+
+    namespace detail
+    {
+        // types of piece, matching PRINTF_OP_*
+        enum piece_type : unsigned char
+        {
+            TEXT = PRINTF_OP_TEXT, // run of len ascii chars starting at start
+            CODE = PRINTF_OP_CODE, // single unicode char held in len
+            CONV = PRINTF_OP_CONV  // format specifier conv (with l, prec, flags and width) for argument number arg
+        };
+
+        /*
+         * A piece of a format string parsed at compile time
+        */
+        struct piece
+        {
+            piece_type type = TEXT;
+            char conv = 0;
+            bool l = false;
+            int prec = -1;
+            int flags = 0;
+            int width = 0;
+            int start = 0;
+            int len = 0;
+            int arg = 0;
+            int width_arg = 0; // argument number of a * width
+            int prec_arg = 0; // argument number of a .* precision
+        };
+
+        /*
+         * Compile time version of _utf8_lead
+         * Returns the number of bytes in the utf-8 char starting with the bytes lead and next, or 0 if they can't
+         * start a valid one (overlong forms, surrogates and codes above 0x10ffff)
+        */
+        constexpr int utf8_lead(unsigned char lead, unsigned char next)
+        {
+            if(lead < 0xc2 || lead > 0xf4)
+            {
+                return 0;
+            }
+            const unsigned char low = lead == 0xe0 ? 0xa0 : lead == 0xf0 ? 0x90 : 0x80;
+            const unsigned char high = lead == 0xed ? 0x9f : lead == 0xf4 ? 0x8f : 0xbf;
+            if(next < low || next > high)
+            {
+                return 0;
+            }
+            return lead < 0xe0 ? 2 : lead < 0xf0 ? 3 : 4;
+        }
+
+        /*
+         * Compile time version of decode_char
+         * Returns the number of bytes in the utf-8 char at str and sets code to it, or 0 if it is invalid
+         * Valid means the same as for decode_char
+        */
+        constexpr int decode_char(const char* str, int& code)
+        {
+            const unsigned char c = str[0];
+            int bytes = 0;
+            if((c & 0x80) == 0)
+            {
+                code = c;
+                return 1;
+            }
+            else if(utf8_lead(c, str[1]) == 0)
+            {
+                return 0;
+            }
+            else if((c & 0xe0) == 0xc0)
+            {
+                code = c & 0x1f;
+                bytes = 2;
+            }
+            else if((c & 0xf0) == 0xe0)
+            {
+                code = c & 0xf;
+                bytes = 3;
+            }
+            else if((c & 0xf8) == 0xf0)
+            {
+                code = c & 0x7;
+                bytes = 4;
+            }
+            else
+            {
+                return 0;
+            }
+            for(int i = 1; i < bytes; i++)
+            {
+                const unsigned char next = str[i];
+                if((next & 0xc0) != 0x80)
+                {
+                    return 0;
+                }
+                code = (code << 6) | (next & 0x3f);
+            }
+            return bytes;
+        }
+
+        /*
+         * Compile time version of _parse_op
+         * Parses the piece of str starting at pos into p and returns the number of chars used
+        */
+        constexpr int parse_piece(const char* str, int pos, piece& p)
+        {
+            p = piece{};
+            if(str[pos] == '%')
+            {
+                int len = 1;
+                for(;; len++)
+                {
+                    if(str[pos + len] == '-')
+                    {
+                        p.flags |= PRINTF_FLAG_LEFT;
+                    }
+                    else if(str[pos + len] == '0')
+                    {
+                        p.flags |= PRINTF_FLAG_ZERO;
+                    }
+                    else
+                    {
+                        break;
+                    }
+                }
+                if(str[pos + len] == '*')
+                {
+                    p.width = PRINTF_WIDTH_ARG;
+                    len++;
+                }
+                while(p.width >= 0 && str[pos + len] >= '0' && str[pos + len] <= '9')
+                {
+                    p.width = p.width * 10 + str[pos + len] - '0';
+                    if(p.width > PRINTF_MAX_WIDTH)
+                    {
+                        p.width = PRINTF_MAX_WIDTH;
+                    }
+                    len++;
+                }
+                if(str[pos + len] == '.' && str[pos + len + 1] == '*')
+                {
+                    p.prec = PRINTF_PREC_ARG;
+                    len += 2;
+                }
+                else if(str[pos + len] == '.')
+                {
+                    len++;
+                    p.prec = 0;
+                    while(str[pos + len] >= '0' && str[pos + len] <= '9')
+                    {
+                        p.prec = p.prec * 10 + str[pos + len] - '0';
+                        if(p.prec > PRINTF_MAX_PRECISION)
+                        {
+                            p.prec = PRINTF_MAX_PRECISION;
+                        }
+                        len++;
+                    }
+                }
+                if(str[pos + len] == 'l')
+                {
+                    p.l = true;
+                    len++;
+                }
+                const char conv = str[pos + len];
+                switch(conv)
+                {
+                    case 'd':
+                    case 'u':
+                    case 'b':
+                    case 'o':
+                    case 'h':
+                    {
+                        if(p.prec == -1)
+                        {
+                            p.type = CONV;
+                            p.conv = conv;
+                            return len + 1;
+                        }
+                        break;
+                    }
+                    case 'f':
+                    case 'e':
+                    {
+                        if(!p.l)
+                        {
+                            p.type = CONV;
+                            p.conv = conv;
+                            return len + 1;
+                        }
+                        break;
+                    }
+                    case 's':
+                    {
+                        if(!p.l)
+                        {
+                            p.type = CONV;
+                            p.conv = conv;
+                            return len + 1;
+                        }
+                        break;
+                    }
+                    case 'c':
+                    case '%':
+                    {
+                        if(!p.l && p.prec == -1 && (conv != '%' || (p.flags == 0 && p.width == 0)))
+                        {
+                            if(conv == '%')
+                            {
+                                // %% is just the text "%"
+                                p.start = pos + 1;
+                                p.len = 1;
+                            }
+                            else
+                            {
+                                p.type = CONV;
+                                p.conv = conv;
+                            }
+                            return len + 1;
+                        }
+                        break;
+                    }
+                    default:
+                    {
+                        break;
+                    }
+                }
+                // invalid specifier
+                p.type = CODE;
+                p.len = p.l || p.prec != -1 || p.flags != 0 || p.width != 0 ? '?' : '%';
+                return len;
+            }
+            int run = 0;
+            while(str[pos + run] != 0 && str[pos + run] != '%' && (str[pos + run] & 0x80) == 0)
+            {
+                run++;
+            }
+            if(run > 0)
+            {
+                p.start = pos;
+                p.len = run;
+                return run;
+            }
+            p.type = CODE;
+            int bytes = decode_char(&(str[pos]), p.len);
+            if(bytes == 0)
+            {
+                p.len = '?';
+                bytes = 1;
+            }
+            return bytes;
+        }
+
+        /*
+         * Returns the number of pieces in the format string F
+        */
+        template<format_string F>
+        constexpr std::size_t count_pieces()
+        {
+            std::size_t count = 0;
+            int pos = 0;
+            while(F.str[pos] != 0)
+            {
+                piece p;
+                pos += parse_piece(F.str, pos, p);
+                count++;
+            }
+            return count;
+        }
+
+        /*
+         * Parses the format string F into its pieces, numbering the arguments of the format specifiers
+        */
+        template<format_string F>
+        constexpr std::array<piece, count_pieces<F>()> parse()
+        {
+            std::array<piece, count_pieces<F>()> pieces{};
+            int pos = 0;
+            int arg = 0;
+            for(piece& p : pieces)
+            {
+                pos += parse_piece(F.str, pos, p);
+                if(p.type == CONV)
+                {
+                    if(p.width == PRINTF_WIDTH_ARG)
+                    {
+                        p.width_arg = arg;
+                        arg++;
+                    }
+                    if(p.prec == PRINTF_PREC_ARG)
+                    {
+                        p.prec_arg = arg;
+                        arg++;
+                    }
+                    p.arg = arg;
+                    arg++;
+                }
+            }
+            return pieces;
+        }
+
+        /*
+         * Returns the number of arguments the pieces of a format string take
+        */
+        template<std::size_t N>
+        constexpr int count_args(const std::array<piece, N>& pieces)
+        {
+            int count = 0;
+            for(const piece& p : pieces)
+            {
+                count += p.type == CONV;
+                count += p.type == CONV && p.width == PRINTF_WIDTH_ARG;
+                count += p.type == CONV && p.prec == PRINTF_PREC_ARG;
+            }
+            return count;
+        }
+
+        template<typename T>
+        constexpr bool is_char_v = std::is_same_v<T, char> || std::is_same_v<T, signed char> ||
+            std::is_same_v<T, unsigned char>;
+
+        template<typename T>
+        constexpr bool is_integer_v = std::is_integral_v<T> && !std::is_same_v<T, bool>;
+
+        // strings printed with their length rather than up to a NUL
+        template<typename T>
+        constexpr bool is_string_view_v = !std::is_convertible_v<T, const char*> &&
+            std::is_convertible_v<T, std::string_view>;
+
+        /*
+         * Returns whether an argument of type T can be printed with the format specifier conv (with l)
+        */
+        template<char Conv, bool L, typename T>
+        constexpr bool arg_matches()
+        {
+            constexpr std::size_t max_size = L ? 8 : 4;
+            if constexpr(Conv == 'd')
+            {
+                return is_integer_v<T> && std::is_signed_v<T> && sizeof(T) <= max_size;
+            }
+            else if constexpr(Conv == 'u' || Conv == 'b' || Conv == 'o' || Conv == 'h')
+            {
+                return is_integer_v<T> && std::is_unsigned_v<T> && sizeof(T) <= max_size;
+            }
+            else if constexpr(Conv == 'f' || Conv == 'e')
+            {
+                return std::is_same_v<T, float> || std::is_same_v<T, double>;
+            }
+            else if constexpr(Conv == 's')
+            {
+                return std::is_convertible_v<T, const char*> || is_string_view_v<T>;
+            }
+            else
+            {
+                return is_char_v<T>;
+            }
+        }
+
+        /*
+         * Prints the argument arg of a specifier P with flags, a width or a precision, taking a * width and .*
+         * precision from args
+         * Returns the number of characters printed
+        */
+        template<piece P, typename T, typename Tuple>
+        int print_field(printf_ctx* ctx, const T& arg, const Tuple& args)
+        {
+            printf_spec spec{P.conv, P.l, (int16_t)P.prec, (char)P.flags, (int16_t)P.width};
+            if constexpr(P.width == PRINTF_WIDTH_ARG)
+            {
+                const auto& width = std::get<P.width_arg>(args);
+                using W = std::decay_t<decltype(width)>;
+                static_assert(is_integer_v<W> && sizeof(W) <= 4, "yaos::print * width must be an integer of up to 32 bits");
+                yaos_set_width(&spec, (int)width);
+            }
+            if constexpr(P.prec == PRINTF_PREC_ARG)
+            {
+                const auto& prec = std::get<P.prec_arg>(args);
+                using R = std::decay_t<decltype(prec)>;
+                static_assert(is_integer_v<R> && sizeof(R) <= 4, "yaos::print .* precision must be an integer of up to 32 bits");
+                yaos_set_prec(&spec, (int)prec);
+            }
+            printf_value value;
+            if constexpr(std::is_same_v<T, float>)
+            {
+                return yaos_format_float32(ctx, &spec, arg);
+            }
+            else if constexpr(is_string_view_v<T>)
+            {
+                const std::string_view view = arg;
+                std::size_t len = view.size();
+                if(spec.prec >= 0 && (std::size_t)spec.prec < len)
+                {
+                    len = spec.prec;
+                }
+                return yaos_format_string(ctx, &spec, view.data(), (int)len);
+            }
+            else if constexpr(P.conv == 'd')
+            {
+                value.i = (int64_t)arg;
+            }
+            else if constexpr(P.conv == 'c')
+            {
+                value.i = (char)arg;
+            }
+            else if constexpr(P.conv == 'f' || P.conv == 'e')
+            {
+                value.d = arg;
+            }
+            else if constexpr(P.conv == 's')
+            {
+                value.s = arg;
+            }
+            else
+            {
+                value.u = (uint64_t)arg;
+            }
+            return yaos_format_value(ctx, &spec, value);
+        }
+
+        /*
+         * Prints piece P of format string F, taking its argument (if it has one) from args
+         * Returns the number of characters printed
+        */
+        template<format_string F, piece P, typename Tuple>
+        int print_piece(printf_ctx* ctx, const Tuple& args)
+        {
+            if constexpr(P.type == TEXT)
+            {
+                put_ref(ctx, &(F.str[P.start]), P.len);
+                return P.len;
+            }
+            else if constexpr(P.type == CODE)
+            {
+                put_char(ctx, P.len);
+                return 1;
+            }
+            else
+            {
+                const auto& arg = std::get<P.arg>(args);
+                using T = std::decay_t<decltype(arg)>;
+                static_assert(arg_matches<P.conv, P.l, T>(), "yaos::print argument type doesn't match its format specifier");
+                if constexpr(P.flags != 0 || P.width != 0 || P.prec == PRINTF_PREC_ARG || (P.conv == 's' && P.prec >= 0))
+                {
+                    return print_field<P>(ctx, arg, args);
+                }
+                else if constexpr(P.conv == 'd')
+                {
+                    return print_int(ctx, (int64_t)arg);
+                }
+                else if constexpr(P.conv == 'u')
+                {
+                    return print_unsigned_int(ctx, (uint64_t)arg);
+                }
+                else if constexpr(P.conv == 'b')
+                {
+                    return print_bin(ctx, (uint64_t)arg);
+                }
+                else if constexpr(P.conv == 'o')
+                {
+                    return print_oct(ctx, (uint64_t)arg);
+                }
+                else if constexpr(P.conv == 'h')
+                {
+                    return print_hex(ctx, (uint64_t)arg);
+                }
+                else if constexpr(P.conv == 'f' && P.prec >= 0)
+                {
+                    return print_float_prec(ctx, (double)arg, P.prec);
+                }
+                else if constexpr(P.conv == 'f' && std::is_same_v<T, float>)
+                {
+                    return print_float32(ctx, arg);
+                }
+                else if constexpr(P.conv == 'f')
+                {
+                    return print_float(ctx, (double)arg);
+                }
+                else if constexpr(P.conv == 'e' && P.prec >= 0)
+                {
+                    return print_float_scientific_prec(ctx, (double)arg, P.prec);
+                }
+                else if constexpr(P.conv == 'e' && std::is_same_v<T, float>)
+                {
+                    return print_float32_scientific(ctx, arg);
+                }
+                else if constexpr(P.conv == 'e')
+                {
+                    return print_float_scientific(ctx, (double)arg);
+                }
+                else if constexpr(P.conv == 's' && is_string_view_v<T>)
+                {
+                    const std::string_view view = arg;
+                    return print_string_n(ctx, view.data(), (int)view.size());
+                }
+                else if constexpr(P.conv == 's')
+                {
+                    return print_string(ctx, arg);
+                }
+                else
+                {
+                    return print_char(ctx, (char)arg);
+                }
+            }
+        }
+
+        template<format_string F, typename Tuple, std::size_t... I>
+        int print_pieces(printf_ctx* ctx, const Tuple& args, std::index_sequence<I...>)
+        {
+            constexpr auto pieces = parse<F>();
+            int n = 0;
+            // comma fold so the pieces are printed in order
+            ((n += print_piece<F, pieces[I]>(ctx, args)), ...);
+            return n;
+        }
+    }
+
+    /*
+     * Prints the format string F to ctx with the arguments given
+     * Returns the number of characters printed
+    */
+    template<format_string F, typename... Args>
+    int print(printf_ctx* ctx, const Args&... args)
+    {
+        constexpr auto pieces = detail::parse<F>();
+        static_assert(detail::count_args(pieces) == sizeof...(Args),
+            "yaos::print number of arguments doesn't match the format string");
+        return detail::print_pieces<F>(ctx, std::forward_as_tuple(args...), std::make_index_sequence<pieces.size()>{});
+    }
+
+    /*
+     * Prints the format string F with the arguments given to the context printf uses
+    */
+    template<format_string F, typename... Args>
+    int print(const Args&... args)
+    {
+        return print<F>(get_stdout_ctx(), args...);
+    }
+}
+
+#endif
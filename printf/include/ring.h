@@ -0,0 +1,109 @@
+// License GPL-2.0
+// Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+//
+// Unless required by applicable law or agreed to in writing, this software
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.
+
+#ifndef RING_H
+#define RING_H
+
+#include <printf.h>
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// max number of chars in a single message sent through a printf_ring (longer messages are cut short)
+#ifndef PRINTF_RING_MAX_MESSAGE
+#define PRINTF_RING_MAX_MESSAGE 256
+#endif
+
+// max number of rings in a printf_ring_set
+#ifndef PRINTF_RING_MAX_PRODUCERS
+#define PRINTF_RING_MAX_PRODUCERS 16
+#endif
+
+// alignment keeping what producers write, what the consumer writes and the next ring off each other's cache lines
+#define PRINTF_RING_ALIGN __attribute__((aligned(64)))
+
+/*
+ * Lock free multi producer, single consumer ring buffer for printing from many threads
+ * Each producer formats its message on its own stack, reserves room for the whole message by moving head
+ * with a compare and swap, copies the message in and then commits it by writing its header
+ * The consumer (printf_ring_drain, or the drain thread from printf_ring_start) writes committed messages
+ * to out in order of reservation, so messages are never interleaved
+ *
+ * Each message in the ring is a header followed by its unicode chars
+ * header 0 -> not committed yet
+ * header > 0 -> committed message of header - 1 chars
+ * header < 0 -> skip -header slots to the start of the ring (the message didn't fit before the end)
+ *
+ * buffer, size -> ring of size slots (a power of 2)
+ * head -> total slots reserved by producers
+ * tail -> total slots consumed by the consumer
+ * block -> 1 to wait for room when the ring is full, 0 to drop the message
+ * dropped -> number of messages dropped
+ * out -> where the consumer writes the messages
+ * single -> 1 if only one thread ever formats to the ring, so room is reserved by storing head rather than with
+ * a compare and swap, and tail is only read again when the ring looks full
+ * tail_seen -> tail as the single producer last read it
+*/
+typedef struct printf_ring
+{
+    int* buffer;
+    uint32_t size;
+    int block;
+    int single;
+    printf_ctx* out;
+    uint64_t head PRINTF_RING_ALIGN;
+    uint64_t tail_seen;
+    uint64_t dropped;
+    uint64_t tail PRINTF_RING_ALIGN;
+    pthread_t thread;
+    int running;
+} printf_ring;
+
+void printf_ring_init(printf_ring* ring, int* buffer, uint32_t size, printf_ctx* out);
+int printf_ring_vformat(printf_ring* ring, const char* str, va_list arg_list);
+int printf_ring_format(printf_ring* ring, const char* str, ...);
+int printf_ring_drain(printf_ring* ring);
+int printf_ring_start(printf_ring* ring);
+void printf_ring_stop(printf_ring* ring);
+
+/*
+ * Set of rings, one for each producer thread, drained by a single consumer
+ * Each producer takes a ring of its own with printf_ring_set_join and formats to it with printf_ring_format, so
+ * producers never share a head to reserve room with and adding threads doesn't add contention
+ * Each thread's messages come out whole and in order, but messages from different threads are only ordered by
+ * when the consumer reaches their rings
+ *
+ * rings -> num_rings rings of ring_size slots each
+ * joined -> number of rings taken by producers so far
+ * block -> block setting given to each ring as it is joined
+*/
+typedef struct printf_ring_set
+{
+    printf_ring rings[PRINTF_RING_MAX_PRODUCERS];
+    int num_rings;
+    int joined;
+    int block;
+    pthread_t thread;
+    int running;
+} printf_ring_set;
+
+void printf_ring_set_init(printf_ring_set* set, int* buffer, uint32_t ring_size, int num_rings, printf_ctx* out);
+printf_ring* printf_ring_set_join(printf_ring_set* set);
+int printf_ring_set_drain(printf_ring_set* set);
+int printf_ring_set_start(printf_ring_set* set);
+void printf_ring_set_stop(printf_ring_set* set);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
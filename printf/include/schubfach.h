@@ -0,0 +1,34 @@
+// License GPL-2.0
+// Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+//
+// Unless required by applicable law or agreed to in writing, this software
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.
+
+#ifndef SCHUBFACH_H
+#define SCHUBFACH_H
+
+#include <ryu/ryu.h>
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Schubfach float to decimal engine (Raffaello Giulietti, "The Schubfach way to render doubles")
+ * A drop in replacement for d2d: takes the mantissa and exponent bits of a finite, non zero double and returns
+ * the shortest decimal digits which round trip, picking the closest to the double (ties to even) and with no
+ * trailing zeros, so the result is the same as d2d bit for bit
+ *
+ * Each conversion is 3 64x126 bit multiplies against a single table entry rather than Ryu's loop removing a digit
+ * at a time, with one 617 entry table of powers of 10 instead of Ryu's 2 tables
+*/
+floating_decimal_64 schubfach_d2d(uint64_t ieee_mantissa, uint32_t ieee_exponent);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,85 @@
+// License GPL-2.0
+// Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+//
+// Unless required by applicable law or agreed to in writing, this software
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <printf.h>
+
+#include <stdarg.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// bytes of a field kept other than its runs of padding and zeros: at most a float's exact digits (1100) with its
+// sign, decimal point and exponent
+#define PRINTF_STREAM_FIELD_CHARS 1112
+// runs a field is kept as: padding, sign, zeros, digits, trailing zeros, exponent and padding
+#define PRINTF_STREAM_RUNS 8
+
+/*
+ * Run of a field being streamed, either len bytes of its chars or len copies of fill (if fill isn't 0)
+*/
+typedef struct printf_stream_run
+{
+    int len;
+    char fill;
+} printf_stream_run;
+
+/*
+ * Resumable formatter for output taken in fixed size chunks (such as by a UART or DMA driver)
+ * printf_stream_next fills a chunk with the next UTF-8 bytes of the message and returns whether there is more to
+ * come, carrying on from exactly where the last chunk stopped, so a message of any length is streamed with no
+ * buffer for the whole message
+ *
+ * Text of the format string and %s arguments are streamed straight from where they are, with their padding kept
+ * as a count
+ * Other fields are printed once, when the stream reaches them, into runs of chars and of fill, so padding and the
+ * zeros of a long precision such as %.30000f are only counts and the chars fit in PRINTF_STREAM_FIELD_CHARS
+ * Each chunk then copies on from the run and byte the last one stopped at
+ *
+ * The arguments are read from a copy of the va_list, so the variadic call they came from must not return until
+ * the stream is finished and printf_stream_end is called
+ *
+ * str -> rest of the format string
+ * args -> rest of the arguments
+ * text, text_len -> text being streamed (from the format string or a %s argument) and its bytes left
+ * valid -> bytes at the start of text already checked to be valid UTF-8
+ * pad_before, pad_after -> spaces left to stream before and after text
+ * chars, runs, num_runs -> field being streamed, as num_runs runs whose chars are in turn in chars
+ * run, run_pos, chars_pos -> run being streamed, bytes of it already sent and chars of the field already sent
+ * sig_figs -> significant figures %f and %e print to with no precision (as for a printf_ctx)
+*/
+typedef struct printf_stream
+{
+    const char* str;
+    va_list args;
+    const char* text;
+    int text_len;
+    int valid;
+    int pad_before;
+    int pad_after;
+    char chars[PRINTF_STREAM_FIELD_CHARS];
+    printf_stream_run runs[PRINTF_STREAM_RUNS];
+    int num_runs;
+    int run;
+    int run_pos;
+    int chars_pos;
+    int sig_figs;
+} printf_stream;
+
+void printf_stream_init(printf_stream* stream, const char* str, va_list arg_list);
+int printf_stream_next(printf_stream* stream, char* chunk, int size, int* len);
+void printf_stream_end(printf_stream* stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,295 @@
+#!/usr/bin/env python3
+# License GPL-2.0
+# Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+#
+# Unless required by applicable law or agreed to in writing, this software
+# is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.
+
+"""
+Generates the lookup tables of the float to decimal engines (Ryu in vendor/ryu and Schubfach in src)
+
+ f2d -> vendor/ryu/f2d_full_table.h, the tables for 32 bit floats
+ d2d_small -> vendor/ryu/d2d_small_table.h, the compact tables d2d uses with RYU_OPTIMIZE_SIZE
+              Every entry of the full double tables is rebuilt from them here and checked to be exact
+
+ schubfach -> src/schubfach_table.h, the 126 bit powers of 10 Schubfach uses
+
+Usage: python3 scripts/ryu_tables.py f2d > vendor/ryu/f2d_full_table.h
+       python3 scripts/ryu_tables.py d2d_small > vendor/ryu/d2d_small_table.h
+       python3 scripts/ryu_tables.py schubfach > src/schubfach_table.h
+"""
+
+import sys
+
+FLOAT_POW5_INV_BITCOUNT = 59
+FLOAT_POW5_BITCOUNT = 61
+DOUBLE_POW5_INV_BITCOUNT = 125
+DOUBLE_POW5_BITCOUNT = 125
+# powers of 5 multiplied into the base entries of the small double tables (5 ^ 25 is the largest kept)
+POW5_TABLE_SIZE = 26
+MASK64 = (1 << 64) - 1
+# range of the decimal exponent k Schubfach scales doubles by 10 ^ -k with
+SCHUBFACH_K_MIN = -324
+SCHUBFACH_K_MAX = 292
+
+# float exponent range once the bias, mantissa bits and the 2 extra bits Ryu uses are taken off
+FLOAT_E2_MIN = 1 - 127 - 23 - 2
+FLOAT_E2_MAX = 254 - 127 - 23 - 2
+DOUBLE_E2_MIN = 1 - 1023 - 52 - 2
+DOUBLE_E2_MAX = 2046 - 1023 - 52 - 2
+
+HEADER = """// License GPL-2.0
+// Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+//
+// Unless required by applicable law or agreed to in writing, this software
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.
+//
+// Generated by scripts/ryu_tables.py {name}, do not edit
+"""
+
+
+def pow5bits(e):
+    """ceil(log2(5 ^ e)) (1 for e == 0), as computed by common.h"""
+    return ((e * 1217359) >> 19) + 1
+
+
+def log10_pow2(e):
+    return (e * 78913) >> 18
+
+
+def log10_pow5(e):
+    return (e * 732923) >> 20
+
+
+def pow5_inv_split(q, bitcount):
+    """floor(2 ^ (pow5bits(q) - 1 + bitcount) / 5 ^ q) + 1"""
+    return (1 << (pow5bits(q) - 1 + bitcount)) // (5 ** q) + 1
+
+
+def pow5_split(i, bitcount):
+    """5 ^ i scaled to bitcount bits (truncated)"""
+    shift = pow5bits(i) - bitcount
+    return 5 ** i >> shift if shift >= 0 else 5 ** i << -shift
+
+
+def format_table(name, values, per_line=3):
+    lines = []
+    for start in range(0, len(values), per_line):
+        lines.append("  " + " ".join("%20uu," % v for v in values[start:start + per_line]))
+    lines[-1] = lines[-1].rstrip(",")
+    return "static const uint64_t %s[%d] = {\n%s\n};\n" % (name, len(values), "\n".join(lines))
+
+
+def f2d_table():
+    # f2d looks up q (and q - 1) for e2 >= 0 and i (and i + 1) for e2 < 0
+    inv_size = log10_pow2(FLOAT_E2_MAX) + 1
+    split_size = max(-e2 - log10_pow5(-e2) for e2 in range(FLOAT_E2_MIN, 0)) + 2
+    inv = [pow5_inv_split(q, FLOAT_POW5_INV_BITCOUNT) for q in range(inv_size)]
+    split = [pow5_split(i, FLOAT_POW5_BITCOUNT) for i in range(split_size)]
+    for v in inv + split:
+        assert v < 1 << 64
+    out = HEADER.format(name="f2d")
+    out += "\n#ifndef RYU_F2D_FULL_TABLE_H\n#define RYU_F2D_FULL_TABLE_H\n\n#include <stdint.h>\n\n"
+    out += "#define FLOAT_POW5_INV_BITCOUNT %d\n#define FLOAT_POW5_BITCOUNT %d\n\n" % (
+        FLOAT_POW5_INV_BITCOUNT, FLOAT_POW5_BITCOUNT)
+    out += "#define FLOAT_POW5_INV_TABLE_SIZE %d\n#define FLOAT_POW5_TABLE_SIZE %d\n\n" % (inv_size, split_size)
+    out += "// floor(2 ^ (pow5bits(q) - 1 + FLOAT_POW5_INV_BITCOUNT) / 5 ^ q) + 1\n"
+    out += format_table("FLOAT_POW5_INV_SPLIT", inv).replace("[%d]" % inv_size, "[FLOAT_POW5_INV_TABLE_SIZE]")
+    out += "\n// 5 ^ i scaled to FLOAT_POW5_BITCOUNT bits\n"
+    out += format_table("FLOAT_POW5_SPLIT", split).replace("[%d]" % split_size, "[FLOAT_POW5_TABLE_SIZE]")
+    out += "\n#endif // RYU_F2D_FULL_TABLE_H\n"
+    return out
+
+
+def format_table128(name, size, values):
+    lines = ["  { %20uu, %20uu }," % (v & MASK64, v >> 64) for v in values]
+    lines[-1] = lines[-1].rstrip(",")
+    return "static const uint64_t %s[%s][2] = {\n%s\n};\n" % (name, size, "\n".join(lines))
+
+
+def format_offsets(name, offsets):
+    """packs the 2 bit corrections 16 to a uint32_t, entry i at bits 2 * (i % 16) of word i / 16"""
+    words = [0] * ((len(offsets) + 15) // 16)
+    for i, off in enumerate(offsets):
+        assert 0 <= off <= 3, "correction out of range for entry %d" % i
+        words[i // 16] |= off << (2 * (i % 16))
+    lines = []
+    for start in range(0, len(words), 4):
+        lines.append("  " + " ".join("0x%08xu," % w for w in words[start:start + 4]))
+    lines[-1] = lines[-1].rstrip(",")
+    return "static const uint32_t %s[%d] = {\n%s\n};\n" % (name, len(words), "\n".join(lines))
+
+
+def small_pow5(i, base_value, base2):
+    """the top 128 bits of 5 ^ (i - base2) times the base entry, as double_computePow5 takes them"""
+    product = 5 ** (i - base2) * base_value
+    return (product >> (pow5bits(i) - pow5bits(base2))) & ((1 << 128) - 1)
+
+
+def small_inv_pow5(i, base_value, base2):
+    """the top 128 bits of 5 ^ (base2 - i) times the base entry, as double_computeInvPow5 takes them"""
+    product = 5 ** (base2 - i) * base_value
+    return (product >> (pow5bits(base2) - pow5bits(i))) & ((1 << 128) - 1)
+
+
+def correction(exact, approx):
+    """the amount added to the low 64 bits, which must not carry into the high 64 bits"""
+    assert exact >> 64 == approx >> 64, "low half correction would carry"
+    return (exact & MASK64) - (approx & MASK64)
+
+
+SMALL_FUNCTIONS = """
+// Computes 5^i in the form required by Ryu, and stores it in the given pointer.
+static inline void double_computePow5(const uint32_t i, uint64_t* const result) {
+  const uint32_t base = i / POW5_TABLE_SIZE;
+  const uint32_t base2 = base * POW5_TABLE_SIZE;
+  const uint32_t offset = i - base2;
+  assert(base < DOUBLE_POW5_SPLIT2_SIZE);
+  const uint64_t* const mul = DOUBLE_POW5_SPLIT2[base];
+  if (offset == 0) {
+    result[0] = mul[0];
+    result[1] = mul[1];
+    return;
+  }
+  const uint64_t m = DOUBLE_POW5_TABLE[offset];
+  uint64_t high1;
+  const uint64_t low1 = umul128(m, mul[1], &high1);
+  uint64_t high0;
+  const uint64_t low0 = umul128(m, mul[0], &high0);
+  const uint64_t sum = high0 + low1;
+  if (sum < high0) {
+    ++high1; // overflow into high1
+  }
+  // high1 | sum | low0
+  const uint32_t delta = pow5bits(i) - pow5bits(base2);
+  result[0] = shiftright128(low0, sum, delta) + ((POW5_OFFSETS[i / 16] >> ((i % 16) << 1)) & 3);
+  result[1] = shiftright128(sum, high1, delta);
+}
+
+// Computes 5^-i in the form required by Ryu, and stores it in the given pointer.
+static inline void double_computeInvPow5(const uint32_t i, uint64_t* const result) {
+  const uint32_t base = (i + POW5_TABLE_SIZE - 1) / POW5_TABLE_SIZE;
+  const uint32_t base2 = base * POW5_TABLE_SIZE;
+  const uint32_t offset = base2 - i;
+  assert(base < DOUBLE_POW5_INV_SPLIT2_SIZE);
+  const uint64_t* const mul = DOUBLE_POW5_INV_SPLIT2[base]; // 1/5^base2
+  if (offset == 0) {
+    result[0] = mul[0];
+    result[1] = mul[1];
+    return;
+  }
+  const uint64_t m = DOUBLE_POW5_TABLE[offset]; // 5^offset
+  uint64_t high1;
+  const uint64_t low1 = umul128(m, mul[1], &high1);
+  uint64_t high0;
+  const uint64_t low0 = umul128(m, mul[0], &high0);
+  const uint64_t sum = high0 + low1;
+  if (sum < high0) {
+    ++high1; // overflow into high1
+  }
+  // high1 | sum | low0
+  const uint32_t delta = pow5bits(base2) - pow5bits(i);
+  result[0] = shiftright128(low0, sum, delta) - 1 + ((POW5_INV_OFFSETS[i / 16] >> ((i % 16) << 1)) & 3);
+  result[1] = shiftright128(sum, high1, delta);
+}
+"""
+
+
+def d2d_small_table():
+    # the indices d2d looks up: q for e2 >= 0 and i for e2 < 0
+    inv_size = log10_pow2(DOUBLE_E2_MAX) - 1 + 1
+    split_size = max(-e2 - (log10_pow5(-e2) - (-e2 > 1)) for e2 in range(DOUBLE_E2_MIN, 0)) + 1
+    split_bases = [pow5_split(b * POW5_TABLE_SIZE, DOUBLE_POW5_BITCOUNT)
+                   for b in range((split_size - 1) // POW5_TABLE_SIZE + 1)]
+    inv_bases = [pow5_inv_split(b * POW5_TABLE_SIZE, DOUBLE_POW5_INV_BITCOUNT)
+                 for b in range((inv_size - 1 + POW5_TABLE_SIZE - 1) // POW5_TABLE_SIZE + 1)]
+    split_offsets = []
+    for i in range(split_size):
+        base2 = i // POW5_TABLE_SIZE * POW5_TABLE_SIZE
+        exact = pow5_split(i, DOUBLE_POW5_BITCOUNT)
+        approx = exact if i == base2 else small_pow5(i, split_bases[base2 // POW5_TABLE_SIZE], base2)
+        split_offsets.append(correction(exact, approx))
+    inv_offsets = []
+    for i in range(inv_size):
+        base2 = (i + POW5_TABLE_SIZE - 1) // POW5_TABLE_SIZE * POW5_TABLE_SIZE
+        exact = pow5_inv_split(i, DOUBLE_POW5_INV_BITCOUNT)
+        approx = exact if i == base2 else small_inv_pow5(i, inv_bases[base2 // POW5_TABLE_SIZE], base2)
+        # the rebuilt inverse can be 1 over as well as under, so its corrections are stored plus 1
+        inv_offsets.append(correction(exact, approx) + 1)
+    for v in split_bases + inv_bases:
+        assert v < 1 << 128
+
+    out = HEADER.format(name="d2d_small")
+    out += "\n#ifndef RYU_D2D_SMALL_TABLE_H\n#define RYU_D2D_SMALL_TABLE_H\n\n"
+    out += "#include <assert.h>\n#include <stdint.h>\n\n#include \"common.h\"\n#include \"d2d_intrinsics.h\"\n\n"
+    out += "#define DOUBLE_POW5_INV_BITCOUNT %d\n#define DOUBLE_POW5_BITCOUNT %d\n\n" % (
+        DOUBLE_POW5_INV_BITCOUNT, DOUBLE_POW5_BITCOUNT)
+    out += "#define POW5_TABLE_SIZE %d\n#define DOUBLE_POW5_INV_SPLIT2_SIZE %d\n#define DOUBLE_POW5_SPLIT2_SIZE %d\n\n" % (
+        POW5_TABLE_SIZE, len(inv_bases), len(split_bases))
+    out += "// 5 ^ i for the offsets from a base entry\n"
+    out += format_table("DOUBLE_POW5_TABLE", [5 ** i for i in range(POW5_TABLE_SIZE)]).replace(
+        "[%d]" % POW5_TABLE_SIZE, "[POW5_TABLE_SIZE]")
+    out += "\n// every POW5_TABLE_SIZE'th entry of DOUBLE_POW5_SPLIT in d2d_full_table.h\n"
+    out += format_table128("DOUBLE_POW5_SPLIT2", "DOUBLE_POW5_SPLIT2_SIZE", split_bases)
+    out += "\n// 2 bit corrections added to the low half of the rebuilt DOUBLE_POW5_SPLIT entries\n"
+    out += format_offsets("POW5_OFFSETS", split_offsets)
+    out += "\n// every POW5_TABLE_SIZE'th entry of DOUBLE_POW5_INV_SPLIT in d2d_full_table.h\n"
+    out += format_table128("DOUBLE_POW5_INV_SPLIT2", "DOUBLE_POW5_INV_SPLIT2_SIZE", inv_bases)
+    out += "\n// 2 bit corrections (plus 1) added to the low half of the rebuilt DOUBLE_POW5_INV_SPLIT entries\n"
+    out += format_offsets("POW5_INV_OFFSETS", inv_offsets)
+    out += SMALL_FUNCTIONS
+    out += "\n#endif // RYU_D2D_SMALL_TABLE_H\n"
+    return out
+
+
+def flog2_pow10(e):
+    """floor(log2(10 ^ e)), as computed by schubfach.c"""
+    return (e * 913124641741) >> 38
+
+
+def schubfach_g(k):
+    """floor(10 ^ -k * 2 ^ (125 - floor(log2(10 ^ -k)))) + 1, which is in [2 ^ 125, 2 ^ 126)"""
+    shift = 125 - flog2_pow10(-k)
+    num, den = 1, 1
+    if -k >= 0:
+        num *= 10 ** -k
+    else:
+        den *= 10 ** k
+    if shift >= 0:
+        num <<= shift
+    else:
+        den <<= -shift
+    g = num // den + 1
+    assert 1 << 125 <= g < 1 << 126
+    return g
+
+
+def schubfach_table():
+    mask63 = (1 << 63) - 1
+    lines = []
+    for k in range(SCHUBFACH_K_MIN, SCHUBFACH_K_MAX + 1):
+        g = schubfach_g(k)
+        lines.append("    {0x%016xull, 0x%016xull}, // %d" % (g >> 63, g & mask63, k))
+    lines[-1] = lines[-1].replace("},", "} ", 1)
+    out = HEADER.format(name="schubfach")
+    out += "\n#ifndef SCHUBFACH_TABLE_H\n#define SCHUBFACH_TABLE_H\n\n#include <stdint.h>\n\n"
+    out += "#define SCHUBFACH_K_MIN %d\n#define SCHUBFACH_K_MAX %d\n\n" % (SCHUBFACH_K_MIN, SCHUBFACH_K_MAX)
+    out += "/*\n * 10 ^ -k as g = floor(10 ^ -k * 2 ^ (125 - floor(log2(10 ^ -k)))) + 1, in [2 ^ 125, 2 ^ 126)\n"
+    out += " * Each entry is the top 63 bits of g followed by the bottom 63 bits, for k from SCHUBFACH_K_MIN\n*/\n"
+    out += "static const uint64_t SCHUBFACH_G[SCHUBFACH_K_MAX - SCHUBFACH_K_MIN + 1][2] = {\n%s\n};\n" % "\n".join(lines)
+    out += "\n#endif\n"
+    return out
+
+
+TABLES = {
+    "f2d": f2d_table,
+    "d2d_small": d2d_small_table,
+    "schubfach": schubfach_table,
+}
+
+if __name__ == "__main__":
+    if len(sys.argv) != 2 or sys.argv[1] not in TABLES:
+        sys.exit("usage: ryu_tables.py {%s}" % ",".join(TABLES))
+    sys.stdout.write(TABLES[sys.argv[1]]())
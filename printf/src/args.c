@@ -0,0 +1,208 @@
+// License GPL-2.0
+// Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+//
+// Unless required by applicable law or agreed to in writing, this software
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.
+
+#include <args.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Internal function
+ * Returns whether arg has the right type for the format specifier spec, setting value to it if so
+*/
+int _arg_matches(const printf_spec* spec, const printf_arg* arg, printf_value* value)
+{
+    switch(spec->conv)
+    {
+        case 'd':
+        {
+            if(arg->type == PRINTF_ARG_INT32)
+            {
+                value->i = (int32_t)arg->value.i;
+                return 1;
+            }
+            value->i = arg->value.i;
+            return spec->l && arg->type == PRINTF_ARG_INT64;
+        }
+        case 'u':
+        case 'b':
+        case 'o':
+        case 'h':
+        {
+            if(arg->type == PRINTF_ARG_UINT32)
+            {
+                value->u = (uint32_t)arg->value.u;
+                return 1;
+            }
+            value->u = arg->value.u;
+            return spec->l && arg->type == PRINTF_ARG_UINT64;
+        }
+        case 'f':
+        case 'e':
+        {
+            value->d = arg->value.d;
+            return arg->type == PRINTF_ARG_DOUBLE;
+        }
+        case 's':
+        {
+            value->s = arg->value.s;
+            return arg->type == PRINTF_ARG_STRING && arg->value.s != NULL;
+        }
+        case 'c':
+        {
+            value->i = (char)arg->value.i;
+            return arg->type == PRINTF_ARG_INT32 || arg->type == PRINTF_ARG_UINT32;
+        }
+        default:
+        {
+            return 0;
+        }
+    }
+}
+
+/*
+ * Internal function
+ * Takes the argument at *pos of args for a * width or .* precision, moving *pos past it
+ * val is left as it is if there are no arguments left or the argument isn't a 32 bit integer
+*/
+void _arg_int(const printf_arg* args, int num_args, int* pos, int* val)
+{
+    if(*pos >= num_args)
+    {
+        return;
+    }
+    const printf_arg* arg = &(args[*pos]);
+    (*pos)++;
+    if(arg->type == PRINTF_ARG_INT32)
+    {
+        *val = (int32_t)arg->value.i;
+    }
+    else if(arg->type == PRINTF_ARG_UINT32)
+    {
+        *val = (uint32_t)arg->value.u > INT32_MAX ? INT32_MAX : (int)arg->value.u;
+    }
+}
+
+/*
+ * Internal function
+ * Prints the piece op of a format string, taking the arguments of a format specifier from args starting at *pos
+ * and moving *pos past them
+ * Returns the number of chars printed
+*/
+int _format_arg_op(printf_ctx* ctx, const printf_op* op, const printf_arg* args, int num_args, int* pos)
+{
+    switch(op->type)
+    {
+        case PRINTF_OP_TEXT:
+        {
+            put_ref(ctx, op->str, op->len);
+            return op->len;
+        }
+        case PRINTF_OP_CODE:
+        {
+            put_char(ctx, op->len);
+            return 1;
+        }
+        default:
+        {
+            break;
+        }
+    }
+    printf_spec spec = op->spec;
+    if(spec.width == PRINTF_WIDTH_ARG)
+    {
+        int width = 0;
+        _arg_int(args, num_args, pos, &width);
+        yaos_set_width(&spec, width);
+    }
+    if(spec.prec == PRINTF_PREC_ARG)
+    {
+        int prec = -1;
+        _arg_int(args, num_args, pos, &prec);
+        yaos_set_prec(&spec, prec);
+    }
+    printf_value value;
+    if(*pos >= num_args || !_arg_matches(&spec, &(args[*pos]), &value))
+    {
+        (*pos)++;
+        put_chars(ctx, "?", 1);
+        return 1;
+    }
+    (*pos)++;
+    return yaos_format_value(ctx, &spec, value);
+}
+
+/*
+ * Prints a format string compiled by yaos_compile to ctx, taking the arguments from the num_args tagged
+ * arguments in args
+ * Returns number of characters outputted
+*/
+int printf_args_format_compiled(printf_ctx* ctx, const printf_op* ops, int num_ops, const printf_arg* args,
+    int num_args)
+{
+    int num = 0;
+    int pos = 0;
+    for(int i = 0; i < num_ops; i++)
+    {
+        num += _format_arg_op(ctx, &(ops[i]), args, num_args, &pos);
+    }
+    return num;
+}
+
+/*
+ * Prints the format string str to ctx, taking the arguments from the num_args tagged arguments in args rather
+ * than a va_list
+ * The format string is compiled with ctx's cache if it has one
+ * Returns number of characters outputted
+*/
+int printf_args_format(printf_ctx* ctx, const char* str, const printf_arg* args, int num_args)
+{
+    if(ctx->cache != NULL)
+    {
+        const printf_cache_entry* entry = printf_cache_lookup(ctx->cache, str);
+        if(entry != NULL)
+        {
+            return printf_args_format_compiled(ctx, entry->ops, entry->num_ops, args, num_args);
+        }
+    }
+    int num = 0;
+    int pos = 0;
+    while(*str != 0)
+    {
+        printf_op op;
+        str += yaos_parse_op(str, &op);
+        num += _format_arg_op(ctx, &op, args, num_args, &pos);
+    }
+    return num;
+}
+
+/*
+ * Prints num_records records to ctx with the one format string str
+ * args holds the args_per_record tagged arguments of each record one after the other
+ * The format string is only parsed once for all the records (unless it has more than PRINTF_BATCH_OPS pieces)
+ * Returns number of characters outputted
+*/
+int printf_args_format_batch(printf_ctx* ctx, const char* str, const printf_arg* args, int args_per_record,
+    int num_records)
+{
+    printf_op ops[PRINTF_BATCH_OPS];
+    int num_ops = yaos_compile(str, ops, PRINTF_BATCH_OPS);
+    int num = 0;
+    for(int i = 0; i < num_records; i++)
+    {
+        const printf_arg* record = &(args[i * args_per_record]);
+        if(num_ops <= PRINTF_BATCH_OPS)
+        {
+            num += printf_args_format_compiled(ctx, ops, num_ops, record, args_per_record);
+        }
+        else
+        {
+            num += printf_args_format(ctx, str, record, args_per_record);
+        }
+    }
+    return num;
+}
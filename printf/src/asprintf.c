@@ -0,0 +1,108 @@
+// License GPL-2.0
+// Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+//
+// Unless required by applicable law or agreed to in writing, this software
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.
+
+#include <asprintf.h>
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+/*
+ * Sets up arena to hand out the size bytes of memory
+*/
+void printf_arena_init(printf_arena* arena, char* memory, size_t size)
+{
+    arena->memory = memory;
+    arena->size = size;
+    arena->used = 0;
+}
+
+/*
+ * Allocator function for a printf_arena (passed as data)
+ * Returns the next size bytes of the arena or NULL if there aren't that many left
+*/
+void* printf_arena_alloc(void* data, size_t size)
+{
+    printf_arena* arena = data;
+    if(size > arena->size - arena->used)
+    {
+        return NULL;
+    }
+    char* bytes = &(arena->memory[arena->used]);
+    arena->used += size;
+    return bytes;
+}
+
+/*
+ * Frees every string taken from arena
+*/
+void printf_arena_reset(printf_arena* arena)
+{
+    arena->used = 0;
+}
+
+/*
+ * Returns an allocator taking its strings from arena
+*/
+printf_allocator printf_arena_allocator(printf_arena* arena)
+{
+    printf_allocator allocator = {
+        .alloc = printf_arena_alloc,
+        .data = arena
+    };
+    return allocator;
+}
+
+/*
+ * Formats str to a UTF-8 string of exactly the right size taken from allocator (or malloc if it is NULL)
+ * The length is measured first with yaos_vmeasure so the string is allocated once and formatted once
+ * out is set to the 0 terminated string, or NULL if it couldn't be allocated
+ * Returns the number of bytes written to the string (not including the terminator) or -1 if it couldn't be
+ * allocated or the formatted string didn't fit in the bytes measured (out is then freed if it came from malloc
+ * and set to NULL)
+*/
+int yaos_vasprintf(const printf_allocator* allocator, char** out, const char* str, va_list arg_list)
+{
+    int len = yaos_vmeasure(str, arg_list);
+    char* buffer;
+    if(allocator != NULL)
+    {
+        buffer = allocator->alloc(allocator->data, len + 1);
+    }
+    else
+    {
+        buffer = malloc(len + 1);
+    }
+    *out = buffer;
+    if(buffer == NULL)
+    {
+        return -1;
+    }
+    printf_ctx ctx;
+    printf_ctx_init_utf8_buffer(&ctx, buffer, len);
+    yaos_vformat(&ctx, str, arg_list);
+    buffer[ctx.buffer_index] = 0;
+    if(ctx.utf8_length != ctx.buffer_index)
+    {
+        if(allocator == NULL)
+        {
+            free(buffer);
+        }
+        *out = NULL;
+        return -1;
+    }
+    return ctx.buffer_index;
+}
+
+int yaos_asprintf(const printf_allocator* allocator, char** out, const char* str, ...)
+{
+    va_list arg_list;
+    va_start(arg_list, str);
+    int len = yaos_vasprintf(allocator, out, str, arg_list);
+    va_end(arg_list);
+    return len;
+}
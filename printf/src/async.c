@@ -0,0 +1,350 @@
+// License GPL-2.0
+// Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+//
+// Unless required by applicable law or agreed to in writing, this software
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.
+
+#include <async.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Sets up async to write to fd through num_buffers buffers of buffer_size bytes in memory
+ * num_buffers is kept between 2 and PRINTF_ASYNC_MAX_BUFFERS
+*/
+void printf_async_init(printf_async* async, int fd, char* memory, int num_buffers, int buffer_size)
+{
+    if(num_buffers > PRINTF_ASYNC_MAX_BUFFERS)
+    {
+        num_buffers = PRINTF_ASYNC_MAX_BUFFERS;
+    }
+    async->fd = fd;
+    async->memory = memory;
+    async->num_buffers = num_buffers < 2 ? 2 : num_buffers;
+    async->buffer_size = buffer_size;
+    for(int i = 0; i < async->num_buffers; i++)
+    {
+        async->lengths[i] = 0;
+        async->messages[i] = 0;
+        async->free[i] = i;
+    }
+    async->queue_start = 0;
+    async->queue_count = 0;
+    async->free_count = async->num_buffers - 1;
+    async->fill = async->num_buffers - 1;
+    async->flush_size = buffer_size;
+    async->flush_newline = 0;
+    async->flush_ms = 0;
+    async->policy = PRINTF_ASYNC_BLOCK;
+    async->sig_figs = PRINTF_SIG_FIGS;
+    async->dropped = 0;
+    async->writes = 0;
+    async->error = 0;
+    pthread_mutex_init(&(async->lock), NULL);
+    pthread_cond_init(&(async->work), NULL);
+    pthread_cond_init(&(async->room), NULL);
+    async->running = 0;
+    async->writing = 0;
+}
+
+/*
+ * Internal function
+ * Writes the bytes in buffer id to the file descriptor, carrying on from where a short write stopped, then
+ * empties it
+*/
+void _async_write(printf_async* async, int id)
+{
+    const char* bytes = &(async->memory[id * async->buffer_size]);
+    int len = async->lengths[id];
+    while(len > 0)
+    {
+        ssize_t written = write(async->fd, bytes, len);
+        async->writes++;
+        if(written < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            async->error = errno;
+            break;
+        }
+        bytes += written;
+        len -= written;
+    }
+    async->lengths[id] = 0;
+    async->messages[id] = 0;
+}
+
+/*
+ * Internal function
+ * Takes the oldest buffer off the queue
+ * Must be called with the lock held
+*/
+int _async_pop(printf_async* async)
+{
+    int id = async->queue[async->queue_start];
+    async->queue_start = (async->queue_start + 1) % async->num_buffers;
+    async->queue_count--;
+    return id;
+}
+
+/*
+ * Internal function
+ * Queues the buffer being filled for the flusher and starts filling a free one
+ * Must be called with the lock held and a free buffer
+*/
+void _async_submit(printf_async* async)
+{
+    async->queue[(async->queue_start + async->queue_count) % async->num_buffers] = async->fill;
+    async->queue_count++;
+    async->free_count--;
+    async->fill = async->free[async->free_count];
+    pthread_cond_signal(&(async->work));
+}
+
+/*
+ * Internal function
+ * Makes sure there is a free buffer, as the policy says when there isn't one
+ * Blocking without the flusher running writes the oldest buffer from the calling thread
+ * Must be called with the lock held
+ * Returns 1 if there is a free buffer or 0 if the message should be dropped
+*/
+int _async_room(printf_async* async)
+{
+    while(async->free_count == 0)
+    {
+        if(async->policy == PRINTF_ASYNC_DROP_NEWEST)
+        {
+            return 0;
+        }
+        if(async->policy == PRINTF_ASYNC_DROP_OLDEST)
+        {
+            // the buffer being written can't be dropped, only those still waiting
+            if(async->queue_count == 0)
+            {
+                return 0;
+            }
+            int id = _async_pop(async);
+            async->dropped += async->messages[id];
+            async->lengths[id] = 0;
+            async->messages[id] = 0;
+            async->free[async->free_count] = id;
+            async->free_count++;
+            return 1;
+        }
+        if(!async->running)
+        {
+            // no flusher to wait for, so write the oldest buffer from this thread
+            int id = _async_pop(async);
+            _async_write(async, id);
+            async->free[async->free_count] = id;
+            async->free_count++;
+            continue;
+        }
+        pthread_cond_wait(&(async->room), &(async->lock));
+    }
+    return 1;
+}
+
+/*
+ * Formats a message and copies it whole into the buffer being filled
+ * Safe to call from any number of threads at once
+ * Returns the number of bytes in the message or -1 if it was dropped
+*/
+int printf_async_vformat(printf_async* async, const char* str, va_list arg_list)
+{
+    char message[PRINTF_ASYNC_MAX_MESSAGE];
+    printf_ctx ctx;
+    printf_ctx_init_utf8_buffer(&ctx, message, PRINTF_ASYNC_MAX_MESSAGE);
+    ctx.sig_figs = async->sig_figs;
+    yaos_vformat(&ctx, str, arg_list);
+    int len = ctx.buffer_index < async->buffer_size ? ctx.buffer_index : async->buffer_size;
+
+    pthread_mutex_lock(&(async->lock));
+    if(len > async->buffer_size - async->lengths[async->fill])
+    {
+        if(!_async_room(async))
+        {
+            async->dropped++;
+            pthread_mutex_unlock(&(async->lock));
+            return -1;
+        }
+        _async_submit(async);
+    }
+    int fill = async->fill;
+    memcpy(&(async->memory[fill * async->buffer_size + async->lengths[fill]]), message, len);
+    async->lengths[fill] += len;
+    async->messages[fill]++;
+    int trigger = async->lengths[fill] >= async->flush_size ||
+        (async->flush_newline && memchr(message, '\n', len) != NULL);
+    if(trigger && async->free_count > 0)
+    {
+        _async_submit(async);
+    }
+    pthread_mutex_unlock(&(async->lock));
+    return len;
+}
+
+int printf_async_format(printf_async* async, const char* str, ...)
+{
+    va_list arg_list;
+    va_start(arg_list, str);
+    int len = printf_async_vformat(async, str, arg_list);
+    va_end(arg_list);
+    return len;
+}
+
+/*
+ * Writes everything formatted so far, waiting for the flusher to write it if it is running or else writing it
+ * from this thread
+ * Returns 0 or -1 if a write has failed (with its errno in async->error)
+*/
+int printf_async_flush(printf_async* async)
+{
+    pthread_mutex_lock(&(async->lock));
+    if(async->running)
+    {
+        while(async->lengths[async->fill] > 0 && async->free_count == 0)
+        {
+            pthread_cond_wait(&(async->room), &(async->lock));
+        }
+        if(async->lengths[async->fill] > 0)
+        {
+            _async_submit(async);
+        }
+        while(async->queue_count > 0 || async->writing)
+        {
+            pthread_cond_wait(&(async->room), &(async->lock));
+        }
+    }
+    else
+    {
+        while(async->queue_count > 0)
+        {
+            int id = _async_pop(async);
+            _async_write(async, id);
+            async->free[async->free_count] = id;
+            async->free_count++;
+        }
+        _async_write(async, async->fill);
+    }
+    int result = async->error != 0 ? -1 : 0;
+    pthread_mutex_unlock(&(async->lock));
+    return result;
+}
+
+/*
+ * Internal function
+ * Waits for a buffer to be queued, handing over the buffer being filled if flush_ms passes with nothing queued
+ * Must be called with the lock held
+*/
+void _async_wait(printf_async* async)
+{
+    if(async->flush_ms <= 0)
+    {
+        pthread_cond_wait(&(async->work), &(async->lock));
+        return;
+    }
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += async->flush_ms / 1000;
+    until.tv_nsec += (long)(async->flush_ms % 1000) * 1000000;
+    if(until.tv_nsec >= 1000000000)
+    {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000;
+    }
+    int err = pthread_cond_timedwait(&(async->work), &(async->lock), &until);
+    // with nothing queued or being written every other buffer is free
+    if(err == ETIMEDOUT && async->queue_count == 0 && async->lengths[async->fill] > 0)
+    {
+        _async_submit(async);
+    }
+}
+
+/*
+ * Internal function
+ * Flusher thread, writing each queued buffer with the lock released and what is left once stopped
+*/
+void* _async_thread(void* data)
+{
+    printf_async* async = (printf_async*)data;
+    pthread_mutex_lock(&(async->lock));
+    while(1)
+    {
+        if(async->queue_count == 0)
+        {
+            if(!async->running)
+            {
+                break;
+            }
+            _async_wait(async);
+            continue;
+        }
+        int id = _async_pop(async);
+        async->writing = 1;
+        pthread_mutex_unlock(&(async->lock));
+        _async_write(async, id);
+        pthread_mutex_lock(&(async->lock));
+        async->writing = 0;
+        async->free[async->free_count] = id;
+        async->free_count++;
+        pthread_cond_broadcast(&(async->room));
+    }
+    _async_write(async, async->fill);
+    pthread_mutex_unlock(&(async->lock));
+    return NULL;
+}
+
+/*
+ * Starts the flusher thread
+ * Returns 0 on success or the pthread_create error
+*/
+int printf_async_start(printf_async* async)
+{
+    pthread_mutex_lock(&(async->lock));
+    async->running = 1;
+    pthread_mutex_unlock(&(async->lock));
+    int err = pthread_create(&(async->thread), NULL, _async_thread, async);
+    if(err != 0)
+    {
+        async->running = 0;
+    }
+    return err;
+}
+
+/*
+ * Stops the flusher thread once it has written every message formatted so far
+ * No messages may be formatted while it stops
+*/
+void printf_async_stop(printf_async* async)
+{
+    pthread_mutex_lock(&(async->lock));
+    if(!async->running)
+    {
+        pthread_mutex_unlock(&(async->lock));
+        return;
+    }
+    async->running = 0;
+    pthread_cond_signal(&(async->work));
+    pthread_mutex_unlock(&(async->lock));
+    pthread_join(async->thread, NULL);
+}
+
+/*
+ * Frees the lock and conditions of async (stopping the flusher first if it is running)
+*/
+void printf_async_destroy(printf_async* async)
+{
+    printf_async_stop(async);
+    pthread_mutex_destroy(&(async->lock));
+    pthread_cond_destroy(&(async->work));
+    pthread_cond_destroy(&(async->room));
+}
@@ -0,0 +1,1069 @@
+// License: GPL-2.0
+// Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+//
+// Unless required by applicable law or agreed to in writing, this software
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.
+
+/*
+ * Benchmark suite
+ * Times each conversion on its own and realistic log lines, against glibc snprintf where it has an
+ * equivalent conversion, as well as the cache, deferred logging, scatter-gather output, tagged argument
+ * batches, chunked streaming, asynchronous output, measuring and threaded printing
+ *
+ * Arguments:
+ * --csv -> print one comma separated line per result (for tracking regressions across versions)
+ * --perf -> also count cycles and instructions per call with perf_event_open (Linux only, needs
+ *           perf_event_paranoid to allow it, otherwise the counts are left blank)
+ * --engines -> only time the float to decimal engines themselves (Ryu, labelled with the table configuration it
+ *              was built with, and Schubfach). make engine_bench runs it with both tables, after the size of each
+ *
+ * libc uses the closest standard conversion, so %h is %#x and %ld is %lld, while %f and %e print the
+ * shortest round trip digits here but 6 decimals in libc
+*/
+
+#include <printf.h>
+#include <deferred.h>
+#include <ring.h>
+#include <iov.h>
+#include <args.h>
+#include <stream.h>
+#include <async.h>
+#include <asprintf.h>
+#include <ryu/ryu.h>
+#include <schubfach.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define BENCH_BUFFER_LENGTH 0x400
+#define BENCH_ITERATIONS 200000
+#define BENCH_MAX_THREADS 8
+#define BENCH_RING_SIZE 0x10000
+#define BENCH_DUMP_LENGTH 0x800
+
+#ifdef RYU_OPTIMIZE_SIZE
+#define RYU_TABLES "ryu small"
+#else
+#define RYU_TABLES "ryu full"
+#endif
+
+int bench_buffer[BENCH_BUFFER_LENGTH];
+char libc_buffer[BENCH_BUFFER_LENGTH];
+char utf8_buffer[BENCH_BUFFER_LENGTH];
+
+/*
+ * Returns the current time in nanoseconds
+*/
+uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/*
+ * Result of running a benchmark
+ * cycles and instructions are -1 when they weren't counted
+*/
+typedef struct bench_result
+{
+    uint64_t calls;
+    uint64_t elapsed;
+    uint64_t bytes;
+    int64_t cycles;
+    int64_t instructions;
+} bench_result;
+
+int csv_output = 0;
+
+// perf_event_open file descriptors for cycles and instructions (-1 when not counting)
+int perf_fds[2] = {-1, -1};
+
+/*
+ * Opens the cycle and instruction counters for this thread
+*/
+void perf_open()
+{
+#ifdef __linux__
+    const uint64_t configs[2] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS};
+    for(int i = 0; i < 2; i++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = configs[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        perf_fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+    if(perf_fds[0] < 0 || perf_fds[1] < 0)
+    {
+        fprintf(stderr, "perf_event_open unavailable, not counting cycles and instructions\n");
+    }
+}
+
+/*
+ * Resets and starts the counters
+*/
+void perf_start()
+{
+#ifdef __linux__
+    for(int i = 0; i < 2; i++)
+    {
+        if(perf_fds[i] >= 0)
+        {
+            ioctl(perf_fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(perf_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+}
+
+/*
+ * Stops the counters and stores their counts in res
+*/
+void perf_stop(bench_result* res)
+{
+    int64_t counts[2] = {-1, -1};
+#ifdef __linux__
+    for(int i = 0; i < 2; i++)
+    {
+        if(perf_fds[i] >= 0)
+        {
+            ioctl(perf_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            uint64_t count;
+            if(read(perf_fds[i], &count, sizeof(count)) == sizeof(count))
+            {
+                counts[i] = count;
+            }
+        }
+    }
+#endif
+    res->cycles = counts[0];
+    res->instructions = counts[1];
+}
+
+/*
+ * Prints a result as a table row or a csv line
+*/
+void report(const char* group, const char* name, const char* impl, const bench_result* res)
+{
+    double ns = (double)res->elapsed / res->calls;
+    double bytes_per_second = res->bytes / (res->elapsed / 1e9);
+    char cycles[32] = "";
+    char instructions[32] = "";
+    if(res->cycles >= 0)
+    {
+        snprintf(cycles, 32, "%.1f", (double)res->cycles / res->calls);
+    }
+    if(res->instructions >= 0)
+    {
+        snprintf(instructions, 32, "%.1f", (double)res->instructions / res->calls);
+    }
+    if(csv_output)
+    {
+        printf("%s,%s,%s,%lu,%.2f,%.0f,%s,%s\n", group, name, impl, (unsigned long)res->calls, ns,
+            bytes_per_second, cycles, instructions);
+    }
+    else
+    {
+        printf("%-12s %-14s %-9s %8.1f ns/call %9.1f MB/s %9s cyc %9s ins\n", group, name, impl, ns,
+            bytes_per_second / 1e6, cycles, instructions);
+    }
+}
+
+/*
+ * Runs the line function BENCH_ITERATIONS times into the capture buffer and reports the throughput
+*/
+void run_bench(const char* group, const char* name, const char* impl, int (*line)(int))
+{
+    bench_result res;
+    res.calls = BENCH_ITERATIONS;
+    res.bytes = 0;
+    perf_start();
+    uint64_t start = now_ns();
+    for(int i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        set_buffer(bench_buffer, BENCH_BUFFER_LENGTH);
+        res.bytes += line(i);
+    }
+    res.elapsed = now_ns() - start;
+    perf_stop(&res);
+    report(group, name, impl, &res);
+}
+
+/*
+ * Defines the pair of functions timing a single conversion, one with printf and one with libc snprintf
+*/
+#define SPEC_BENCH(name, format, libc_format, arg) \
+    int spec_##name(int i) \
+    { \
+        return my_printf(format, arg); \
+    } \
+    int libc_##name(int i) \
+    { \
+        return snprintf(libc_buffer, BENCH_BUFFER_LENGTH, libc_format, arg); \
+    }
+
+SPEC_BENCH(d_small, "%d", "%d", i & 0xff)
+SPEC_BENCH(d, "%d", "%d", (int32_t)(i * 2654435761u))
+SPEC_BENCH(ld, "%ld", "%lld", (long long)(i * 0x9e3779b97f4a7c15ull))
+SPEC_BENCH(u, "%u", "%u", i * 2654435761u)
+SPEC_BENCH(h, "%h", "%#x", i * 2654435761u)
+SPEC_BENCH(lh, "%lh", "%#llx", (unsigned long long)(i * 0x9e3779b97f4a7c15ull))
+SPEC_BENCH(o, "%o", "%#o", i * 2654435761u)
+SPEC_BENCH(f_small, "%f", "%f", 1.0 / (i + 3))
+SPEC_BENCH(f_one, "%f", "%f", 1.5 + i)
+SPEC_BENCH(f_large, "%f", "%f", 1e15 + i * 0.25)
+SPEC_BENCH(f_huge, "%f", "%f", 1e300 * (i + 1))
+SPEC_BENCH(f_subnormal, "%f", "%f", 8e-310 + i * 1e-320)
+SPEC_BENCH(e, "%e", "%e", 101325.0 + i * 0.1)
+SPEC_BENCH(f_prec3, "%.3f", "%.3f", 20.0 + i * 0.001)
+SPEC_BENCH(f_prec10, "%.10f", "%.10f", 1.0 / (i + 3))
+SPEC_BENCH(f_prec_tiny, "%.30f", "%.30f", 1e-20 * (i + 1))
+SPEC_BENCH(f_prec_huge, "%.2f", "%.2f", 1e300 * (i + 1))
+SPEC_BENCH(f_prec_minus300, "%.2f", "%.2f", 1e-300 * (i + 1))
+SPEC_BENCH(f_prec_minus100, "%.2f", "%.2f", 1e-100 * (i + 1))
+SPEC_BENCH(e_prec3, "%.3e", "%.3e", 101325.0 + i * 0.1)
+SPEC_BENCH(e_prec3_minus300, "%.3e", "%.3e", 1e-300 * (i + 1))
+SPEC_BENCH(e_prec3_minus10, "%.3e", "%.3e", 1e-10 * (i + 1))
+SPEC_BENCH(e_prec17, "%.17e", "%.17e", 1.0 / (i + 3))
+SPEC_BENCH(s_ascii, "%s", "%s", (i & 1) ? "scheduler: idle task entered" : "scheduler: idle task exited")
+SPEC_BENCH(s_utf8, "%s", "%s", (i & 1) ? "temp\xc3\xa9rature \xc3\xa9lev\xc3\xa9" "e \xe2\x9c\x93" : "\xce\xb1\xce\xb2\xce\xb3 \xe2\x86\x92 \xce\xb4")
+SPEC_BENCH(c, "%c", "%c", (char)('a' + (i & 15)))
+SPEC_BENCH(d_width, "%10d", "%10d", (int32_t)(i * 2654435761u) >> 12)
+SPEC_BENCH(h_zero, "%010h", "%#010x", (i * 2654435761u) >> 8)
+SPEC_BENCH(s_left, "%-32s", "%-32s", (i & 1) ? "idle" : "scheduler")
+SPEC_BENCH(f_prec_width, "%12.3f", "%12.3f", 20.0 + i * 0.001)
+// a slice of a longer line, as a parser printing a token would
+#define SLICE_ARGS 8 + (i & 15), "scheduler: idle task entered at tick"
+SPEC_BENCH(s_slice, "%.*s", "%.*s", SLICE_ARGS)
+
+// %b has no libc equivalent before C23
+int spec_b(int i)
+{
+    return my_printf("%b", i * 2654435761u);
+}
+
+// a float through the 32 bit path, and the same float widened to a double as printf's varargs would
+int float32_native(int i)
+{
+    return print_float32(get_stdout_ctx(), 1.0f / (i + 3));
+}
+
+int float32_widened(int i)
+{
+    return print_float(get_stdout_ctx(), 1.0f / (i + 3));
+}
+
+/*
+ * A conversion to time, with libc set to NULL when libc has no equivalent
+*/
+typedef struct spec_case
+{
+    const char* name;
+    int (*yaos)(int);
+    int (*libc)(int);
+} spec_case;
+
+const spec_case spec_cases[] = {
+    {"%d small", spec_d_small, libc_d_small},
+    {"%d", spec_d, libc_d},
+    {"%ld", spec_ld, libc_ld},
+    {"%u", spec_u, libc_u},
+    {"%h", spec_h, libc_h},
+    {"%lh", spec_lh, libc_lh},
+    {"%o", spec_o, libc_o},
+    {"%b", spec_b, NULL},
+    {"%f small", spec_f_small, libc_f_small},
+    {"%f one", spec_f_one, libc_f_one},
+    {"%f 1e15", spec_f_large, libc_f_large},
+    {"%f 1e300", spec_f_huge, libc_f_huge},
+    {"%f subnormal", spec_f_subnormal, libc_f_subnormal},
+    {"%e", spec_e, libc_e},
+    {"%.3f", spec_f_prec3, libc_f_prec3},
+    {"%.10f", spec_f_prec10, libc_f_prec10},
+    {"%.30f tiny", spec_f_prec_tiny, libc_f_prec_tiny},
+    {"%.2f 1e300", spec_f_prec_huge, libc_f_prec_huge},
+    {"%.2f 1e-300", spec_f_prec_minus300, libc_f_prec_minus300},
+    {"%.2f 1e-100", spec_f_prec_minus100, libc_f_prec_minus100},
+    {"%.3e", spec_e_prec3, libc_e_prec3},
+    {"%.3e 1e-300", spec_e_prec3_minus300, libc_e_prec3_minus300},
+    {"%.3e 1e-10", spec_e_prec3_minus10, libc_e_prec3_minus10},
+    {"%.17e", spec_e_prec17, libc_e_prec17},
+    {"%s ascii", spec_s_ascii, libc_s_ascii},
+    {"%s utf-8", spec_s_utf8, libc_s_utf8},
+    {"%c", spec_c, libc_c},
+    {"%10d", spec_d_width, libc_d_width},
+    {"%010h", spec_h_zero, libc_h_zero},
+    {"%-32s", spec_s_left, libc_s_left},
+    {"%12.3f", spec_f_prec_width, libc_f_prec_width},
+    {"%.*s", spec_s_slice, libc_s_slice},
+};
+
+/*
+ * Times each conversion on its own
+*/
+void run_specs()
+{
+    for(unsigned int i = 0; i < sizeof(spec_cases) / sizeof(spec_cases[0]); i++)
+    {
+        run_bench("spec", spec_cases[i].name, "yaos", spec_cases[i].yaos);
+        if(spec_cases[i].libc != NULL)
+        {
+            run_bench("spec", spec_cases[i].name, "libc", spec_cases[i].libc);
+        }
+    }
+    // floats with the shortest round trip digits rather than cut to PRINTF_SIG_FIGS
+    set_sig_figs(PRINTF_SHORTEST);
+    run_bench("spec", "%f shortest", "yaos", spec_f_small);
+    run_bench("spec", "%e shortest", "yaos", spec_e);
+    run_bench("spec", "float shortest", "float32", float32_native);
+    run_bench("spec", "float shortest", "widened", float32_widened);
+    set_sig_figs(PRINTF_SIG_FIGS);
+    run_bench("spec", "float", "float32", float32_native);
+    run_bench("spec", "float", "widened", float32_widened);
+}
+
+/*
+ * Converts a double to its shortest decimal digits with engine and returns the bytes of input converted
+*/
+int engine_convert(floating_decimal_64 (*engine)(uint64_t, uint32_t), double val)
+{
+    uint64_t bits;
+    memcpy(&bits, &val, sizeof(double));
+    floating_decimal_64 dec = engine(bits & 0xfffffffffffffull, (bits >> 52) & 0x7ff);
+    // keep the conversion from being optimised out
+    bench_buffer[0] = (int)dec.mantissa + dec.exponent;
+    return sizeof(double);
+}
+
+// bit patterns spread over every exponent, so every table entry is used
+double spread_double(int i)
+{
+    uint64_t bits = ((uint64_t)(i * 2654435761u) << 32 | (i * 0x9e3779b9u)) % 0x7fe0000000000000ull + 1;
+    double val;
+    memcpy(&val, &bits, sizeof(double));
+    return val;
+}
+
+floating_decimal_64 ryu_engine(uint64_t man, uint32_t exp)
+{
+    return d2d(man, exp);
+}
+
+/*
+ * Defines the functions timing each engine on the doubles given by arg
+*/
+#define ENGINE_BENCH(name, arg) \
+    int ryu_##name(int i) \
+    { \
+        return engine_convert(ryu_engine, arg); \
+    } \
+    int schubfach_##name(int i) \
+    { \
+        return engine_convert(schubfach_d2d, arg); \
+    }
+
+ENGINE_BENCH(small, 1.0 / (i + 3))
+ENGINE_BENCH(large, 1e15 + i * 0.25)
+ENGINE_BENCH(spread, spread_double(i))
+
+/*
+ * Times the float to decimal engines alone, for comparing Ryu's full and small tables and Schubfach
+*/
+void run_engines()
+{
+    run_bench("engine", "small", RYU_TABLES, ryu_small);
+    run_bench("engine", "small", "schubfach", schubfach_small);
+    run_bench("engine", "1e15", RYU_TABLES, ryu_large);
+    run_bench("engine", "1e15", "schubfach", schubfach_large);
+    run_bench("engine", "spread", RYU_TABLES, ryu_spread);
+    run_bench("engine", "spread", "schubfach", schubfach_spread);
+}
+
+/*
+ * Formats a log line with static text only
+*/
+int line_static(int i)
+{
+    (void)i;
+    return my_printf("[kernel] scheduler: idle task entered low power state, waiting for next interrupt\n");
+}
+
+int libc_line_static(int i)
+{
+    (void)i;
+    return snprintf(libc_buffer, BENCH_BUFFER_LENGTH, "[kernel] scheduler: idle task entered low power state, waiting for next interrupt\n");
+}
+
+/*
+ * Formats a log line mixing text with integers
+*/
+int line_int(int i)
+{
+    return my_printf("[trace] task %d switched to core %u at tick %ld\n", i, (uint32_t)(i & 7), (int64_t)i * 1000);
+}
+
+int libc_line_int(int i)
+{
+    return snprintf(libc_buffer, BENCH_BUFFER_LENGTH, "[trace] task %d switched to core %u at tick %lld\n", i, (uint32_t)(i & 7), (long long)i * 1000);
+}
+
+/*
+ * Formats a register dump line
+*/
+int line_hex(int i)
+{
+    return my_printf("r%d=%lh sp=%h flags=%b\n", i & 15, (uint64_t)i * 0x9e3779b97f4a7c15ull, (uint32_t)i << 4, (uint32_t)i & 0xff);
+}
+
+int libc_line_hex(int i)
+{
+    return snprintf(libc_buffer, BENCH_BUFFER_LENGTH, "r%d=%#llx sp=%#x flags=%u\n", i & 15, (unsigned long long)i * 0x9e3779b97f4a7c15ull, (uint32_t)i << 4, (uint32_t)i & 0xff);
+}
+
+/*
+ * Formats a sensor reading line with floats
+*/
+int line_float(int i)
+{
+    return my_printf("sensor %d: temp=%f pressure=%e\n", i & 31, 20.0 + i * 0.001, 101325.0 + i);
+}
+
+int libc_line_float(int i)
+{
+    return snprintf(libc_buffer, BENCH_BUFFER_LENGTH, "sensor %d: temp=%f pressure=%e\n", i & 31, 20.0 + i * 0.001, 101325.0 + i);
+}
+
+/*
+ * Formats a line containing padding heavy subnormal floats
+*/
+int line_subnormal(int i)
+{
+    (void)i;
+    return my_printf("%f\n", 8e-310);
+}
+
+int libc_line_subnormal(int i)
+{
+    (void)i;
+    return snprintf(libc_buffer, BENCH_BUFFER_LENGTH, "%f\n", 8e-310);
+}
+
+/*
+ * Times every log line, with libc as well when compare is set
+*/
+void run_lines(const char* group, int compare)
+{
+    const char* names[] = {"static", "int", "hex", "float", "subnormal"};
+    int (*lines[])(int) = {line_static, line_int, line_hex, line_float, line_subnormal};
+    int (*libc_lines[])(int) = {libc_line_static, libc_line_int, libc_line_hex, libc_line_float, libc_line_subnormal};
+    for(int i = 0; i < 5; i++)
+    {
+        run_bench(group, names[i], "yaos", lines[i]);
+        if(compare)
+        {
+            run_bench(group, names[i], "libc", libc_lines[i]);
+        }
+    }
+}
+
+printf_cache bench_cache;
+printf_stats bench_stats;
+
+uint8_t bench_log_buffer[BENCH_BUFFER_LENGTH];
+printf_log bench_log;
+
+/*
+ * Records the log line of line_int without formatting it
+*/
+int record_int(int i)
+{
+    printf_log_reset(&bench_log);
+    return printf_log_record(&bench_log, "[trace] task %d switched to core %u at tick %ld\n", i, (uint32_t)(i & 7), (int64_t)i * 1000);
+}
+
+/*
+ * Records the log line of line_float without formatting it
+*/
+int record_float(int i)
+{
+    printf_log_reset(&bench_log);
+    return printf_log_record(&bench_log, "sensor %d: temp=%f pressure=%e\n", i & 31, 20.0 + i * 0.001, 101325.0 + i);
+}
+
+/*
+ * Replays the last record of bench_log
+*/
+int replay_float(int i)
+{
+    (void)i;
+    return printf_log_replay(bench_log_buffer, bench_log.index, get_stdout_ctx());
+}
+
+/*
+ * Times recording log lines (the bytes are record bytes) and replaying them
+*/
+void run_deferred()
+{
+    printf_log_init(&bench_log, bench_log_buffer, BENCH_BUFFER_LENGTH);
+    bench_log.cache = &bench_cache;
+    run_bench("deferred", "record int", "yaos", record_int);
+    run_bench("deferred", "record float", "yaos", record_float);
+    run_bench("deferred", "replay float", "yaos", replay_float);
+}
+
+// mostly non-ascii text and a log line with a little of it
+#define UTF8_TEXT(i) ((i) & 1 ? "temp\xc3\xa9rature \xc3\xa9lev\xc3\xa9" "e \xe2\x9c\x93 \xce\xb1\xce\xb2\xce\xb3 \xe2\x86\x92 \xce\xb4" : \
+    "\xe6\xb8\xa9\xe5\xba\xa6\xe3\x82\xbb\xe3\x83\xb3\xe3\x82\xb5 \xe2\x86\x92 \xce\xb1\xce\xb2\xce\xb3")
+#define UTF8_LINE "[%s] \xe2\x9c\x93 task %d: %s\n"
+
+/*
+ * Captures UTF8_TEXT into the unicode char buffer (4 bytes a char, decoding each char)
+*/
+int utf32_string(int i)
+{
+    return my_printf("%s", UTF8_TEXT(i));
+}
+
+/*
+ * Captures UTF8_TEXT as UTF-8 bytes (copied straight through)
+*/
+int utf8_string(int i)
+{
+    return yaos_snprintf_utf8(utf8_buffer, BENCH_BUFFER_LENGTH, "%s", UTF8_TEXT(i));
+}
+
+int utf32_line(int i)
+{
+    return my_printf(UTF8_LINE, "sched", i, UTF8_TEXT(i));
+}
+
+int utf8_line(int i)
+{
+    return yaos_snprintf_utf8(utf8_buffer, BENCH_BUFFER_LENGTH, UTF8_LINE, "sched", i, UTF8_TEXT(i));
+}
+
+/*
+ * Compares capturing output as unicode chars with capturing it as UTF-8 (the bytes are chars for utf-32 and
+ * bytes for utf-8, so the buffer used is 4 times the chars for utf-32)
+*/
+void run_utf8()
+{
+    run_bench("utf8", "%s", "utf-32", utf32_string);
+    run_bench("utf8", "%s", "utf-8", utf8_string);
+    run_bench("utf8", "log line", "utf-32", utf32_line);
+    run_bench("utf8", "log line", "utf-8", utf8_line);
+}
+
+int iov_fd = -1;
+char dump_payload[BENCH_DUMP_LENGTH + 1];
+char dump_buffer[BENCH_DUMP_LENGTH + 0x100];
+struct iovec bench_entries[32];
+char bench_arena[256];
+printf_iov bench_iov;
+
+#define DUMP_LINE "[dump] block %d of %u: %s\n"
+#define SHORT_LINE "[trace] task %d switched to core %u at tick %ld\n"
+
+/*
+ * Starts the file again every so often so it doesn't keep growing
+*/
+void rewind_iov_file(int i)
+{
+    if((i & 255) == 0)
+    {
+        lseek(iov_fd, 0, SEEK_SET);
+    }
+}
+
+/*
+ * Formats a large payload dump into a buffer and writes the buffer
+*/
+int copy_dump(int i)
+{
+    rewind_iov_file(i);
+    int len = yaos_snprintf_utf8(dump_buffer, sizeof(dump_buffer), DUMP_LINE, i, 64u, dump_payload);
+    return write(iov_fd, dump_buffer, len);
+}
+
+/*
+ * Writes a large payload dump with writev, referencing the payload rather than copying it
+*/
+int iov_dump(int i)
+{
+    rewind_iov_file(i);
+    return printf_iov_format(&bench_iov, DUMP_LINE, i, 64u, dump_payload);
+}
+
+int copy_short(int i)
+{
+    rewind_iov_file(i);
+    int len = yaos_snprintf_utf8(dump_buffer, sizeof(dump_buffer), SHORT_LINE, i, (uint32_t)(i & 7), (int64_t)i * 1000);
+    return write(iov_fd, dump_buffer, len);
+}
+
+int iov_short(int i)
+{
+    rewind_iov_file(i);
+    return printf_iov_format(&bench_iov, SHORT_LINE, i, (uint32_t)(i & 7), (int64_t)i * 1000);
+}
+
+/*
+ * Compares formatting into a buffer then writing it with scatter-gather output straight from the format string
+ * and arguments, to a file on tmpfs (/dev/shm, or /tmp if there is none) so the write is a memory copy
+*/
+void run_iov()
+{
+    char path[32];
+    strcpy(path, "/dev/shm/yaos_bench_XXXXXX");
+    iov_fd = mkstemp(path);
+    if(iov_fd < 0)
+    {
+        strcpy(path, "/tmp/yaos_bench_XXXXXX");
+        iov_fd = mkstemp(path);
+    }
+    if(iov_fd < 0)
+    {
+        fprintf(stderr, "no temporary file for the iov benchmark\n");
+        return;
+    }
+    unlink(path);
+    for(int i = 0; i < BENCH_DUMP_LENGTH; i++)
+    {
+        dump_payload[i] = "0123456789abcdef"[i & 15];
+    }
+    dump_payload[BENCH_DUMP_LENGTH] = 0;
+    printf_iov_init(&bench_iov, iov_fd, bench_entries, 32, bench_arena, sizeof(bench_arena));
+    run_bench("iov", "dump 2K", "copy", copy_dump);
+    run_bench("iov", "dump 2K", "writev", iov_dump);
+    run_bench("iov", "log line", "copy", copy_short);
+    run_bench("iov", "log line", "writev", iov_short);
+    close(iov_fd);
+}
+
+#define BATCH_RECORDS 16
+#define BATCH_LINE "%s %u %f\n"
+
+const char* const batch_names[4] = {"cpu.load", "mem.used", "net.rx", "disk.io"};
+printf_arg batch_args[BATCH_RECORDS * 3];
+
+/*
+ * Formats BATCH_RECORDS telemetry records with a printf call each
+*/
+int batch_printf(int i)
+{
+    int n = 0;
+    for(int r = 0; r < BATCH_RECORDS; r++)
+    {
+        n += my_printf(BATCH_LINE, batch_names[r & 3], (uint32_t)(i + r), 0.25 * (r + 1));
+    }
+    return n;
+}
+
+/*
+ * Formats the same records from tagged arguments, one call each
+*/
+int batch_args_each(int i)
+{
+    int n = 0;
+    for(int r = 0; r < BATCH_RECORDS; r++)
+    {
+        batch_args[r * 3 + 1].value.u = i + r;
+        n += printf_args_format(get_stdout_ctx(), BATCH_LINE, &(batch_args[r * 3]), 3);
+    }
+    return n;
+}
+
+/*
+ * Formats the same records in one batch, parsing the format string once
+*/
+int batch_args_all(int i)
+{
+    for(int r = 0; r < BATCH_RECORDS; r++)
+    {
+        batch_args[r * 3 + 1].value.u = i + r;
+    }
+    return printf_args_format_batch(get_stdout_ctx(), BATCH_LINE, batch_args, 3, BATCH_RECORDS);
+}
+
+/*
+ * Compares printf calls with tagged arguments for formatting many records with one format string (the bytes and
+ * times are for BATCH_RECORDS records)
+*/
+void run_batch()
+{
+    for(int r = 0; r < BATCH_RECORDS; r++)
+    {
+        batch_args[r * 3] = PRINTF_STRING(batch_names[r & 3]);
+        batch_args[r * 3 + 1] = PRINTF_UINT32(r);
+        batch_args[r * 3 + 2] = PRINTF_DOUBLE(0.25 * (r + 1));
+    }
+    run_bench("batch", "16 records", "printf", batch_printf);
+    run_bench("batch", "16 records", "args", batch_args_each);
+    run_bench("batch", "16 records", "batch", batch_args_all);
+}
+
+#define STREAM_CHUNK 64
+#define STREAM_LINE "[sensor] node %u sample %d reading %.12f over %s\n"
+
+char stream_chunk[STREAM_CHUNK];
+
+/*
+ * Streams a message in STREAM_CHUNK byte chunks, copying each to the UTF-8 buffer as a driver would send it
+*/
+int stream_chunks(const char* str, ...)
+{
+    va_list args;
+    va_start(args, str);
+    printf_stream stream;
+    printf_stream_init(&stream, str, args);
+    int total = 0;
+    int more = 1;
+    while(more)
+    {
+        int n;
+        more = printf_stream_next(&stream, stream_chunk, STREAM_CHUNK, &n);
+        memcpy(&(utf8_buffer[total]), stream_chunk, n);
+        total += n;
+    }
+    printf_stream_end(&stream);
+    va_end(args);
+    return total;
+}
+
+int whole_line(int i)
+{
+    return yaos_snprintf_utf8(utf8_buffer, BENCH_BUFFER_LENGTH, STREAM_LINE, (uint32_t)(i & 15), i, i * 0.001,
+        "the calibrated range of the first channel");
+}
+
+int stream_line(int i)
+{
+    return stream_chunks(STREAM_LINE, (uint32_t)(i & 15), i, i * 0.001, "the calibrated range of the first channel");
+}
+
+int whole_long(int i)
+{
+    return yaos_snprintf_utf8(utf8_buffer, BENCH_BUFFER_LENGTH, "%.1000f", (i & 7) * 4.9e-324);
+}
+
+int stream_long(int i)
+{
+    return stream_chunks("%.1000f", (i & 7) * 4.9e-324);
+}
+
+/*
+ * Compares formatting a message whole with streaming it in STREAM_CHUNK byte chunks, for a log line and for a
+ * field many chunks long
+*/
+void run_stream()
+{
+    run_bench("stream", "log line", "whole", whole_line);
+    run_bench("stream", "log line", "chunks", stream_line);
+    run_bench("stream", "%.1000f", "whole", whole_long);
+    run_bench("stream", "%.1000f", "chunks", stream_long);
+}
+
+int async_fd = -1;
+char async_memory[2 * 0x1000];
+printf_async bench_async;
+
+/*
+ * Formats a log line into a buffer and writes it from the calling thread
+*/
+int sync_line(int i)
+{
+    int len = yaos_snprintf_utf8(dump_buffer, sizeof(dump_buffer), SHORT_LINE, i, (uint32_t)(i & 7), (int64_t)i * 1000);
+    return write(async_fd, dump_buffer, len);
+}
+
+/*
+ * Formats a log line into the buffer being filled, leaving the write to the flusher
+*/
+int async_line(int i)
+{
+    return printf_async_format(&bench_async, SHORT_LINE, i, (uint32_t)(i & 7), (int64_t)i * 1000);
+}
+
+/*
+ * Compares writing each log line from the formatting thread with double buffered output written by a background
+ * flusher, to /dev/null so only the cost to the formatting thread is timed
+*/
+void run_async()
+{
+    async_fd = open("/dev/null", O_WRONLY);
+    if(async_fd < 0)
+    {
+        fprintf(stderr, "no /dev/null for the async benchmark\n");
+        return;
+    }
+    printf_async_init(&bench_async, async_fd, async_memory, 2, 0x1000);
+    printf_async_start(&bench_async);
+    run_bench("async", "log line", "write", sync_line);
+    run_bench("async", "log line", "async", async_line);
+    printf_async_destroy(&bench_async);
+    close(async_fd);
+}
+
+#define MEASURE_LINE "[sensor] node %u sample %d reading %f range %e name %s\n"
+
+char measure_memory[BENCH_BUFFER_LENGTH];
+printf_arena measure_arena;
+printf_allocator measure_allocator;
+
+/*
+ * Counts the bytes of a line by formatting it to a UTF-8 buffer of size 0
+*/
+int count_line(int i)
+{
+    return yaos_snprintf_utf8(NULL, 0, MEASURE_LINE, (uint32_t)(i & 15), i, i * 0.001, 101325.0 + i, "channel0");
+}
+
+/*
+ * Counts the bytes of the same line from digit counts
+*/
+int measure_line(int i)
+{
+    return yaos_measure(MEASURE_LINE, (uint32_t)(i & 15), i, i * 0.001, 101325.0 + i, "channel0");
+}
+
+int count_short(int i)
+{
+    return yaos_snprintf_utf8(NULL, 0, SHORT_LINE, i, (uint32_t)(i & 7), (int64_t)i * 1000);
+}
+
+int measure_short(int i)
+{
+    return yaos_measure(SHORT_LINE, i, (uint32_t)(i & 7), (int64_t)i * 1000);
+}
+
+/*
+ * Measures the line, takes exactly that from an arena and formats it
+*/
+int asprintf_line(int i)
+{
+    char* str;
+    printf_arena_reset(&measure_arena);
+    return yaos_asprintf(&measure_allocator, &str, MEASURE_LINE, (uint32_t)(i & 15), i, i * 0.001, 101325.0 + i,
+        "channel0");
+}
+
+/*
+ * Compares counting the length of a message by formatting it with nowhere to write against measuring it, and
+ * times a measured asprintf into an arena
+*/
+void run_measure()
+{
+    printf_arena_init(&measure_arena, measure_memory, sizeof(measure_memory));
+    measure_allocator = printf_arena_allocator(&measure_arena);
+    run_bench("measure", "log line", "count", count_line);
+    run_bench("measure", "log line", "measure", measure_line);
+    run_bench("measure", "log line", "asprintf", asprintf_line);
+    run_bench("measure", "int line", "count", count_short);
+    run_bench("measure", "int line", "measure", measure_short);
+}
+
+/*
+ * Sink which throws the output away, standing in for the final output of the threaded benchmarks
+*/
+void null_put_chars(void* data, const char* str, int len)
+{
+    (void)data;
+    (void)str;
+    (void)len;
+}
+
+void null_put_code(void* data, int code)
+{
+    (void)data;
+    (void)code;
+}
+
+void null_put_fill(void* data, char c, int count)
+{
+    (void)data;
+    (void)c;
+    (void)count;
+}
+
+const printf_sink null_sink = {
+    .put_chars = null_put_chars,
+    .put_code = null_put_code,
+    .put_fill = null_put_fill,
+    .data = NULL
+};
+
+printf_ctx thread_out;
+printf_ring bench_ring;
+int bench_ring_slots[BENCH_RING_SIZE];
+printf_ring_set bench_ring_set;
+int bench_ring_set_slots[BENCH_MAX_THREADS * BENCH_RING_SIZE];
+pthread_mutex_t bench_lock = PTHREAD_MUTEX_INITIALIZER;
+int bench_threads;
+
+/*
+ * Producer printing its share of the log lines through the ring
+*/
+void* ring_thread(void* data)
+{
+    (void)data;
+    for(int i = 0; i < BENCH_ITERATIONS / bench_threads; i++)
+    {
+        printf_ring_format(&bench_ring, "[trace] task %d switched to core %u at tick %ld\n", i, (uint32_t)(i & 7), (int64_t)i * 1000);
+    }
+    return NULL;
+}
+
+/*
+ * Producer printing its share of the log lines through a ring of its own
+*/
+void* ring_set_thread(void* data)
+{
+    (void)data;
+    printf_ring* ring = printf_ring_set_join(&bench_ring_set);
+    for(int i = 0; i < BENCH_ITERATIONS / bench_threads; i++)
+    {
+        printf_ring_format(ring, "[trace] task %d switched to core %u at tick %ld\n", i, (uint32_t)(i & 7), (int64_t)i * 1000);
+    }
+    return NULL;
+}
+
+/*
+ * Producer printing its share of the log lines to a single context behind a lock
+*/
+void* lock_thread(void* data)
+{
+    (void)data;
+    for(int i = 0; i < BENCH_ITERATIONS / bench_threads; i++)
+    {
+        pthread_mutex_lock(&bench_lock);
+        yaos_format(&thread_out, "[trace] task %d switched to core %u at tick %ld\n", i, (uint32_t)(i & 7), (int64_t)i * 1000);
+        pthread_mutex_unlock(&bench_lock);
+    }
+    return NULL;
+}
+
+/*
+ * Runs BENCH_ITERATIONS log lines split over threads producer threads and reports the time per message
+ * (bytes and counters aren't tracked across threads)
+*/
+void run_threads(const char* name, void* (*producer)(void*), int threads)
+{
+    pthread_t ids[BENCH_MAX_THREADS];
+    bench_threads = threads;
+    bench_result res;
+    res.calls = BENCH_ITERATIONS / threads * threads;
+    res.bytes = 0;
+    res.cycles = -1;
+    res.instructions = -1;
+    uint64_t start = now_ns();
+    for(int i = 0; i < threads; i++)
+    {
+        pthread_create(&(ids[i]), NULL, producer, NULL);
+    }
+    for(int i = 0; i < threads; i++)
+    {
+        pthread_join(ids[i], NULL);
+    }
+    res.elapsed = now_ns() - start;
+    char full_name[32];
+    snprintf(full_name, 32, "%s %d", name, threads);
+    report("threads", full_name, "yaos", &res);
+}
+
+/*
+ * Compares the shared ring, a ring for each thread and a locked context from 1 to BENCH_MAX_THREADS producers
+*/
+void run_scaling()
+{
+    printf_ctx_init_sink(&thread_out, &null_sink);
+    printf_ring_init(&bench_ring, bench_ring_slots, BENCH_RING_SIZE, &thread_out);
+    bench_ring.block = 1;
+    for(int threads = 1; threads <= BENCH_MAX_THREADS; threads *= 2)
+    {
+        printf_ring_start(&bench_ring);
+        run_threads("ring", ring_thread, threads);
+        printf_ring_stop(&bench_ring);
+        printf_ring_set_init(&bench_ring_set, bench_ring_set_slots, BENCH_RING_SIZE, threads, &thread_out);
+        bench_ring_set.block = 1;
+        printf_ring_set_start(&bench_ring_set);
+        run_threads("rings", ring_set_thread, threads);
+        printf_ring_set_stop(&bench_ring_set);
+        run_threads("lock", lock_thread, threads);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int engines_only = 0;
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--csv") == 0)
+        {
+            csv_output = 1;
+        }
+        else if(strcmp(argv[i], "--perf") == 0)
+        {
+            perf_open();
+        }
+        else if(strcmp(argv[i], "--engines") == 0)
+        {
+            engines_only = 1;
+        }
+    }
+    if(csv_output)
+    {
+        printf("group,name,impl,calls,ns_per_call,bytes_per_second,cycles_per_call,instructions_per_call\n");
+    }
+
+    if(engines_only)
+    {
+        run_engines();
+        return 0;
+    }
+    run_specs();
+    run_engines();
+    run_utf8();
+    run_iov();
+    run_batch();
+    run_stream();
+    run_async();
+    run_measure();
+    run_lines("line", 1);
+    printf_cache_init(&bench_cache);
+    set_cache(&bench_cache);
+    run_lines("line cached", 0);
+    printf_stats_init(&bench_stats);
+    set_stats(&bench_stats);
+    run_lines("line stats", 0);
+    set_stats(NULL);
+    run_deferred();
+    if(!csv_output)
+    {
+        printf("cache hits %lu misses %lu uncached %lu\n", (unsigned long)bench_cache.hits,
+            (unsigned long)bench_cache.misses, (unsigned long)bench_cache.uncached);
+        printf("stats calls %lu latency p50 %lu p99 %lu ticks\n", (unsigned long)bench_stats.calls,
+            (unsigned long)printf_stats_latency(&bench_stats, 50), (unsigned long)printf_stats_latency(&bench_stats, 99));
+    }
+    run_scaling();
+    return 0;
+}
@@ -0,0 +1,357 @@
+// License GPL-2.0
+// Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+//
+// Unless required by applicable law or agreed to in writing, this software
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.
+
+#include <deferred.h>
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+
+// size of the record length and format string pointer at the start of each record
+#define RECORD_HEADER_SIZE (sizeof(uint16_t) + sizeof(const char*))
+
+/*
+ * Sets up log to write records to buffer, which holds size bytes
+*/
+void printf_log_init(printf_log* log, uint8_t* buffer, int size)
+{
+    log->buffer = buffer;
+    log->size = size;
+    log->index = 0;
+    log->dropped = 0;
+    log->cache = NULL;
+}
+
+/*
+ * Discards all records in log (once they have been replayed)
+*/
+void printf_log_reset(printf_log* log)
+{
+    log->index = 0;
+}
+
+/*
+ * Internal function
+ * Gets the next piece of a format string, from entry if the format string is cached or else by parsing str
+ * index is the position in entry and str the position in the format string
+ * Returns 0 once there are no pieces left
+*/
+int _next_op(const printf_cache_entry* entry, int* index, const char** str, printf_op* op)
+{
+    if(entry != NULL)
+    {
+        if(*index >= entry->num_ops)
+        {
+            return 0;
+        }
+        *op = entry->ops[*index];
+        (*index)++;
+        return 1;
+    }
+    if(**str == 0)
+    {
+        return 0;
+    }
+    *str += yaos_parse_op(*str, op);
+    return 1;
+}
+
+/*
+ * Internal function
+ * Returns the number of bytes the raw bits of an argument for spec take in a record (not including strings)
+*/
+int _arg_size(const printf_spec* spec)
+{
+    switch(spec->conv)
+    {
+        case 'c':
+        {
+            return 1;
+        }
+        case 'd':
+        case 'u':
+        case 'b':
+        case 'o':
+        case 'h':
+        {
+            return spec->l ? 8 : 4;
+        }
+        case 'f':
+        case 'e':
+        {
+            return 8;
+        }
+        case 's':
+        {
+            return sizeof(uint16_t);
+        }
+        default:
+        {
+            return 0;
+        }
+    }
+}
+
+/*
+ * Internal function
+ * Appends the argument for spec from args to the record, which has len bytes used out of room
+ * A * width and .* precision are stored as 4 bytes each in front of the argument
+ * A string with a precision only has the bytes it prints stored, as it may not have a NUL after them
+ * Returns the new record length or -1 if the argument doesn't fit
+*/
+int _record_arg(uint8_t* record, int len, int room, const printf_spec* spec, va_list* args)
+{
+    printf_spec resolved = *spec;
+    if(spec->width == PRINTF_WIDTH_ARG && spec->conv != 0)
+    {
+        if(len + (int)sizeof(int32_t) > room)
+        {
+            return -1;
+        }
+        int32_t width = va_arg(*args, int);
+        memcpy(&(record[len]), &width, sizeof(int32_t));
+        len += sizeof(int32_t);
+    }
+    if(spec->prec == PRINTF_PREC_ARG && spec->conv != 0)
+    {
+        if(len + (int)sizeof(int32_t) > room)
+        {
+            return -1;
+        }
+        int32_t prec = va_arg(*args, int);
+        memcpy(&(record[len]), &prec, sizeof(int32_t));
+        len += sizeof(int32_t);
+        yaos_set_prec(&resolved, prec);
+    }
+    int size = _arg_size(spec);
+    if(len + size > room)
+    {
+        return -1;
+    }
+    printf_value value = yaos_read_arg(spec, args);
+    if(spec->conv == 's')
+    {
+        size_t str_len;
+        if(resolved.prec >= 0)
+        {
+            const char* nul = memchr(value.s, 0, resolved.prec);
+            str_len = nul != NULL ? (size_t)(nul - value.s) : (size_t)resolved.prec;
+        }
+        else
+        {
+            str_len = strlen(value.s);
+        }
+        if(str_len > 0xffff || len + size + (int)str_len + 1 > room)
+        {
+            return -1;
+        }
+        uint16_t short_len = str_len;
+        memcpy(&(record[len]), &short_len, sizeof(uint16_t));
+        memcpy(&(record[len + size]), value.s, str_len);
+        record[len + size + str_len] = 0;
+        return len + size + str_len + 1;
+    }
+    // the low bytes of value hold the argument on little endian targets, the high bytes on big endian
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(&(record[len]), &value, size);
+#else
+    memcpy(&(record[len]), ((uint8_t*)&value) + sizeof(value) - size, size);
+#endif
+    return len + size;
+}
+
+/*
+ * Internal function
+ * Reads the argument for spec from the record at *pos and moves *pos past it
+ * A * width and .* precision recorded in front of the argument are set in spec
+*/
+printf_value _replay_arg(const uint8_t* record, int* pos, printf_spec* spec)
+{
+    printf_value value;
+    value.u = 0;
+    if(spec->width == PRINTF_WIDTH_ARG && spec->conv != 0)
+    {
+        int32_t width;
+        memcpy(&width, &(record[*pos]), sizeof(int32_t));
+        *pos += sizeof(int32_t);
+        yaos_set_width(spec, width);
+    }
+    if(spec->prec == PRINTF_PREC_ARG && spec->conv != 0)
+    {
+        int32_t prec;
+        memcpy(&prec, &(record[*pos]), sizeof(int32_t));
+        *pos += sizeof(int32_t);
+        yaos_set_prec(spec, prec);
+    }
+    int size = _arg_size(spec);
+    switch(spec->conv)
+    {
+        case 's':
+        {
+            uint16_t str_len;
+            memcpy(&str_len, &(record[*pos]), sizeof(uint16_t));
+            value.s = (const char*)&(record[*pos + size]);
+            *pos += size + str_len + 1;
+            return value;
+        }
+        case 'c':
+        {
+            value.i = (char)record[*pos];
+            break;
+        }
+        case 'd':
+        {
+            if(spec->l)
+            {
+                memcpy(&(value.i), &(record[*pos]), 8);
+            }
+            else
+            {
+                int32_t d;
+                memcpy(&d, &(record[*pos]), 4);
+                value.i = d;
+            }
+            break;
+        }
+        case 'u':
+        case 'b':
+        case 'o':
+        case 'h':
+        {
+            if(spec->l)
+            {
+                memcpy(&(value.u), &(record[*pos]), 8);
+            }
+            else
+            {
+                uint32_t u;
+                memcpy(&u, &(record[*pos]), 4);
+                value.u = u;
+            }
+            break;
+        }
+        case 'f':
+        case 'e':
+        {
+            memcpy(&(value.d), &(record[*pos]), 8);
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+    *pos += size;
+    return value;
+}
+
+/*
+ * Records format and the raw bits of its arguments from arg_list in log without formatting them
+ * Returns the number of bytes used by the record or 0 if it didn't fit (in which case log->dropped is
+ * incremented and nothing is written)
+*/
+int printf_log_vrecord(printf_log* log, const char* format, va_list arg_list)
+{
+    uint8_t* record = &(log->buffer[log->index]);
+    int room = log->size - log->index;
+    if(room > PRINTF_LOG_MAX_RECORD)
+    {
+        room = PRINTF_LOG_MAX_RECORD;
+    }
+    int len = RECORD_HEADER_SIZE;
+    if(len > room)
+    {
+        log->dropped++;
+        return 0;
+    }
+    memcpy(&(record[sizeof(uint16_t)]), &format, sizeof(const char*));
+
+    va_list args;
+    va_copy(args, arg_list);
+    const printf_cache_entry* entry = log->cache != NULL ? printf_cache_lookup(log->cache, format) : NULL;
+    int index = 0;
+    const char* str = format;
+    printf_op op;
+    while(_next_op(entry, &index, &str, &op))
+    {
+        if(op.type == PRINTF_OP_CONV)
+        {
+            len = _record_arg(record, len, room, &(op.spec), &args);
+            if(len < 0)
+            {
+                va_end(args);
+                log->dropped++;
+                return 0;
+            }
+        }
+    }
+    va_end(args);
+
+    uint16_t record_len = len;
+    memcpy(record, &record_len, sizeof(uint16_t));
+    log->index += len;
+    return len;
+}
+
+int printf_log_record(printf_log* log, const char* format, ...)
+{
+    va_list arg_list;
+    va_start(arg_list, format);
+    int len = printf_log_vrecord(log, format, arg_list);
+    va_end(arg_list);
+    return len;
+}
+
+/*
+ * Formats the len bytes of records written by printf_log_record to ctx
+ * The format strings are parsed again (or taken from ctx->cache if it is set)
+ * Returns the number of characters printed
+*/
+int printf_log_replay(const uint8_t* records, int len, printf_ctx* ctx)
+{
+    int num = 0;
+    int pos = 0;
+    while(pos + (int)RECORD_HEADER_SIZE <= len)
+    {
+        const uint8_t* record = &(records[pos]);
+        uint16_t record_len;
+        const char* format;
+        memcpy(&record_len, record, sizeof(uint16_t));
+        memcpy(&format, &(record[sizeof(uint16_t)]), sizeof(const char*));
+
+        const printf_cache_entry* entry = ctx->cache != NULL ? printf_cache_lookup(ctx->cache, format) : NULL;
+        int index = 0;
+        const char* str = format;
+        int arg_pos = RECORD_HEADER_SIZE;
+        printf_op op;
+        while(_next_op(entry, &index, &str, &op))
+        {
+            switch(op.type)
+            {
+                case PRINTF_OP_TEXT:
+                {
+                    put_ref(ctx, op.str, op.len);
+                    num += op.len;
+                    break;
+                }
+                case PRINTF_OP_CODE:
+                {
+                    put_char(ctx, op.len);
+                    num++;
+                    break;
+                }
+                default:
+                {
+                    printf_value value = _replay_arg(record, &arg_pos, &(op.spec));
+                    num += yaos_format_value(ctx, &(op.spec), value);
+                }
+            }
+        }
+        pos += record_len;
+    }
+    return num;
+}
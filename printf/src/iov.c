@@ -0,0 +1,202 @@
+// License GPL-2.0
+// Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+//
+// Unless required by applicable law or agreed to in writing, this software
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.
+
+#include <iov.h>
+
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/uio.h>
+
+/*
+ * Internal function
+ * Takes up to want bytes of the arena for the message, flushing first if the arena or the entries are full
+ * The bytes are added to the last entry if they follow on from it, or else given a new one
+ * len is set to the number of bytes taken (at least 1)
+ * Returns where the bytes go
+*/
+char* _iov_room(printf_iov* iov, int want, int* len)
+{
+    char* end = &(iov->arena[iov->arena_used]);
+    struct iovec* last = iov->count > 0 ? &(iov->entries[iov->count - 1]) : NULL;
+    int extends = last != NULL && (char*)last->iov_base + last->iov_len == end;
+    if(iov->arena_used == iov->arena_size || (!extends && iov->count == iov->max_entries))
+    {
+        printf_iov_flush(iov);
+        end = iov->arena;
+        extends = 0;
+    }
+    int room = iov->arena_size - iov->arena_used;
+    *len = want < room ? want : room;
+    if(extends)
+    {
+        last->iov_len += *len;
+    }
+    else
+    {
+        iov->entries[iov->count].iov_base = end;
+        iov->entries[iov->count].iov_len = *len;
+        iov->count++;
+    }
+    iov->arena_used += *len;
+    return end;
+}
+
+/*
+ * Sink functions for a printf_iov
+ * Chars, codes and fills are copied into the arena, references get an entry of their own if they are long
+ * enough to be worth it
+*/
+void _iov_put_chars(void* data, const char* str, int len)
+{
+    printf_iov* iov = data;
+    while(len > 0)
+    {
+        int n;
+        char* room = _iov_room(iov, len, &n);
+        memcpy(room, str, n);
+        str += n;
+        len -= n;
+    }
+}
+
+void _iov_put_code(void* data, int code)
+{
+    char bytes[4];
+    int len = encode_char(code, bytes);
+    if(len == 0)
+    {
+        bytes[0] = '?';
+        len = 1;
+    }
+    _iov_put_chars(data, bytes, len);
+}
+
+void _iov_put_fill(void* data, char c, int count)
+{
+    printf_iov* iov = data;
+    while(count > 0)
+    {
+        int n;
+        char* room = _iov_room(iov, count, &n);
+        memset(room, c, n);
+        count -= n;
+    }
+}
+
+void _iov_put_ref(void* data, const char* str, int len)
+{
+    printf_iov* iov = data;
+    if(len < PRINTF_IOV_COPY_MIN)
+    {
+        _iov_put_chars(data, str, len);
+        return;
+    }
+    if(iov->count == iov->max_entries)
+    {
+        printf_iov_flush(iov);
+    }
+    iov->entries[iov->count].iov_base = (void*)str;
+    iov->entries[iov->count].iov_len = len;
+    iov->count++;
+}
+
+/*
+ * Sets up iov to write to fd, building each message in the max_entries entries and the arena_size bytes of arena
+*/
+void printf_iov_init(printf_iov* iov, int fd, struct iovec* entries, int max_entries, char* arena, int arena_size)
+{
+    const printf_sink sink = {
+        .put_chars = _iov_put_chars,
+        .put_code = _iov_put_code,
+        .put_fill = _iov_put_fill,
+        .put_ref = _iov_put_ref,
+        .data = iov
+    };
+    printf_ctx_init_sink(&(iov->ctx), &sink);
+    iov->ctx.utf8 = 1;
+    iov->fd = fd;
+    iov->entries = entries;
+#ifdef IOV_MAX
+    iov->max_entries = max_entries < IOV_MAX ? max_entries : IOV_MAX;
+#else
+    iov->max_entries = max_entries;
+#endif
+    iov->count = 0;
+    iov->arena = arena;
+    iov->arena_size = arena_size;
+    iov->arena_used = 0;
+    iov->writes = 0;
+    iov->error = 0;
+}
+
+/*
+ * Writes the message built so far with writev, carrying on from where a short write stopped
+ * The entries and arena are emptied even if the write fails, dropping the rest of the message
+ * Returns 0 or -1 if the write failed (with its errno in iov->error)
+*/
+int printf_iov_flush(printf_iov* iov)
+{
+    struct iovec* entry = iov->entries;
+    int count = iov->count;
+    int result = 0;
+    while(count > 0)
+    {
+        ssize_t written = writev(iov->fd, entry, count);
+        iov->writes++;
+        if(written < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            iov->error = errno;
+            result = -1;
+            break;
+        }
+        // skip the entries written whole and start the next write part way into the one cut short
+        while(count > 0 && (size_t)written >= entry->iov_len)
+        {
+            written -= entry->iov_len;
+            entry++;
+            count--;
+        }
+        if(count > 0)
+        {
+            entry->iov_base = (char*)entry->iov_base + written;
+            entry->iov_len -= written;
+        }
+    }
+    iov->count = 0;
+    iov->arena_used = 0;
+    return result;
+}
+
+/*
+ * Formats a message and writes it to the file descriptor of iov
+ * Returns the number of chars in the message or -1 if a write failed (with its errno in iov->error)
+*/
+int printf_iov_vformat(printf_iov* iov, const char* str, va_list arg_list)
+{
+    iov->error = 0;
+    int num = yaos_vformat(&(iov->ctx), str, arg_list);
+    if(printf_iov_flush(iov) != 0 || iov->error != 0)
+    {
+        return -1;
+    }
+    return num;
+}
+
+int printf_iov_format(printf_iov* iov, const char* str, ...)
+{
+    va_list args;
+    va_start(args, str);
+    int num = printf_iov_vformat(iov, str, args);
+    va_end(args);
+    return num;
+}
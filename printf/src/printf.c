@@ -8,554 +8,2990 @@
 #include <printf.h>
 
 #include <stdio.h>
+#include <string.h>
 #include <stdarg.h>
 #include <stdint.h>
-#include <alloca.h>
 #include <assert.h>
 #include <ryu/ryu.h>
+#include <schubfach.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif !defined(__aarch64__)
+#include <time.h>
+#endif
 
 #define FLOAT_MANTISSA_BITS 52
 #define FLOAT_MANTISSA_MASK 0xfffffffffffffl
 #define FLOAT_EXP_BITS 11
 #define FLOAT_EXP_MASK 0x7ff
-#define FLOAT_MAX_MAN 100000
+#define FLOAT32_MANTISSA_BITS 23
+#define FLOAT32_MANTISSA_MASK 0x7fffff
+#define FLOAT32_EXP_BITS 8
+#define FLOAT32_EXP_MASK 0xff
 
-int* buffer = NULL;
-int buffer_size = 0;
-int buffer_index = 0;
-
-#ifdef TEST
-void set_buffer(int* stdout_buffer, int size)
-{
-    buffer = stdout_buffer;
-    buffer_size = size;
-    buffer_index = 0;
-}
+#if PRINTF_FLOAT_ENGINE == PRINTF_ENGINE_SCHUBFACH
+#define FLOAT_ENGINE_D2D schubfach_d2d
+#else
+#define FLOAT_ENGINE_D2D d2d
 #endif
 
 /*
- * prints a char to the screen
- * uses stdlib as an example but this would be implementation dependent in reality
+ * Internal function
+ * Counts count chars dropped by a full buffer in the statistics of ctx
 */
-void put_char(int c)
+void _count_truncated(printf_ctx* ctx, int count)
 {
-    if(buffer != NULL && buffer_size > 0)
-    {
-        if(buffer_index < buffer_size)
-        {
-            buffer[buffer_index] = c;
-            buffer_index++;
-        }
-    }
-    else
+    if(ctx->stats != NULL)
     {
-        putc(c, stdout);
+        ctx->stats->truncated += count;
     }
 }
 
 /*
- * Internal function
- * Prints internal ascii char buffer of known length
- * Returns number of characters printed
+ * Buffer sink functions
+ * data is the printf_ctx being written to
+ * Chars which don't fit in the context's buffer are dropped
 */
-int _print_buffer(const char* buffer, int len)
+void _buffer_put_chars(void* data, const char* str, int len)
 {
-    int n = 0;
+    printf_ctx* ctx = (printf_ctx*)data;
+    int room = ctx->buffer_size - ctx->buffer_index;
+    if(len > room)
+    {
+        _count_truncated(ctx, len - room);
+        len = room;
+    }
+    int* dest = &(ctx->buffer[ctx->buffer_index]);
     for(int i = 0; i < len; i++)
     {
-        put_char(buffer[i]);
-        n++;
+        dest[i] = str[i];
     }
-    return n;
+    ctx->buffer_index += len;
 }
 
-/*
- * Internal function
- * Parses the magnitude section of an integer and stores the result in buffer
- * Buffer must be big enough to hold the integer or else have undefined behaviour
- * val > 0 or else will put nothing into the buffer
- * end points to the last character in the buffer (array index)
- * Returns the point in the buffer from which characters were put in it
-*/
-int _parse_int_mag(uint64_t val, char* buffer, int end)
+void _buffer_put_code(void* data, int code)
 {
-    while(val > 0)
+    printf_ctx* ctx = (printf_ctx*)data;
+    if(ctx->buffer_index < ctx->buffer_size)
+    {
+        ctx->buffer[ctx->buffer_index] = code;
+        ctx->buffer_index++;
+    }
+    else
     {
-        buffer[end] = (val % 10) + '0';
-        val /= 10;
-        end--;
+        _count_truncated(ctx, 1);
     }
-    end++;
-    return end;
 }
 
-/*
- * Internal function
- * Like _parse_int_mag except for binary values
-*/
-int _parse_bin_mag(uint64_t val, char* buffer, int end)
+void _buffer_put_fill(void* data, char c, int count)
 {
-    while(val > 0)
+    printf_ctx* ctx = (printf_ctx*)data;
+    int room = ctx->buffer_size - ctx->buffer_index;
+    if(count > room)
     {
-        buffer[end] = (val & 1) + '0';
-        val >>= 1;
-        end--;
+        _count_truncated(ctx, count - room);
+        count = room;
     }
-    end++;
-    return end;
+    int* dest = &(ctx->buffer[ctx->buffer_index]);
+    for(int i = 0; i < count; i++)
+    {
+        dest[i] = c;
+    }
+    ctx->buffer_index += count;
 }
 
 /*
- * Internal function
- * Like _parse_int_mag except for octal values
+ * Encodes the unicode char code as UTF-8 into str, which must have room for 4 bytes
+ * Returns the number of bytes written, or 0 if code isn't a unicode char (negative, a surrogate or above 0x10ffff)
 */
-int _parse_oct_mag(uint64_t val, char* buffer, int end)
+int encode_char(int code, char* str)
 {
-    while(val > 0)
+    if(code < 0)
+    {
+        return 0;
+    }
+    else if(code < 0x80)
+    {
+        str[0] = code;
+        return 1;
+    }
+    else if(code < 0x800)
+    {
+        str[0] = 0xc0 | (code >> 6);
+        str[1] = 0x80 | (code & 0x3f);
+        return 2;
+    }
+    else if(code < 0x10000)
+    {
+        if(code >= 0xd800 && code < 0xe000)
+        {
+            return 0;
+        }
+        str[0] = 0xe0 | (code >> 12);
+        str[1] = 0x80 | ((code >> 6) & 0x3f);
+        str[2] = 0x80 | (code & 0x3f);
+        return 3;
+    }
+    else if(code < 0x110000)
     {
-        buffer[end] = (val & 7) + '0';
-        val >>= 3;
-        end--;
+        str[0] = 0xf0 | (code >> 18);
+        str[1] = 0x80 | ((code >> 12) & 0x3f);
+        str[2] = 0x80 | ((code >> 6) & 0x3f);
+        str[3] = 0x80 | (code & 0x3f);
+        return 4;
     }
-    end++;
-    return end;
+    return 0;
 }
 
 /*
- * Internal function
- * Like _parse_int_mag except for hexadecimal values
+ * UTF-8 buffer sink functions
+ * data is the printf_ctx being written to
+ * Only whole chars are written and once one doesn't fit nothing more is, so the buffer always holds complete
+ * UTF-8 with no gaps. utf8_length keeps counting the bytes which are dropped
 */
-int _parse_hex_mag(uint64_t val, char* buffer, int end)
+void _utf8_buffer_put_chars(void* data, const char* str, int len)
 {
-    while(val > 0)
+    printf_ctx* ctx = (printf_ctx*)data;
+    int write = 0;
+    if(ctx->utf8_length == ctx->buffer_index)
     {
-        int digit = val & 0xf;
-        if(digit < 10)
+        int room = ctx->buffer_size - ctx->buffer_index;
+        write = len < room ? len : room;
+        // don't split the char at the cut
+        while(write < len && write > 0 && (str[write] & 0xc0) == 0x80)
         {
-            buffer[end] = digit + '0';
+            write--;
         }
-        else
+        char* dest = &(ctx->utf8_buffer[ctx->buffer_index]);
+        for(int i = 0; i < write; i++)
         {
-            buffer[end] = (digit - 10) + 'a';
+            dest[i] = str[i];
         }
-        val >>= 4;
-        end--;
+        ctx->buffer_index += write;
+    }
+    if(write < len)
+    {
+        _count_truncated(ctx, len - write);
     }
-    end++;
-    return end;
+    ctx->utf8_length += len;
 }
 
-/*
- * Parses a 64 bit signed integer and prints each character and returns the number of characters printed
- * For 32 bit signed integers, can convert to a 64 bit signed integer and use this function
-*/
-int print_int(int64_t val)
+void _utf8_buffer_put_code(void* data, int code)
 {
-    int n = 0;
-    if(val < 0)
+    char bytes[4];
+    int len = encode_char(code, bytes);
+    if(len == 0)
     {
-        put_char('-');
-        n++;
-        val = -val;
+        bytes[0] = '?';
+        len = 1;
     }
-    else if(val == 0)
+    _utf8_buffer_put_chars(data, bytes, len);
+}
+
+void _utf8_buffer_put_fill(void* data, char c, int count)
+{
+    printf_ctx* ctx = (printf_ctx*)data;
+    int write = 0;
+    if(ctx->utf8_length == ctx->buffer_index)
     {
-        put_char('0');
-        n++;
-        return n;
+        int room = ctx->buffer_size - ctx->buffer_index;
+        write = count < room ? count : room;
+        char* dest = &(ctx->utf8_buffer[ctx->buffer_index]);
+        for(int i = 0; i < write; i++)
+        {
+            dest[i] = c;
+        }
+        ctx->buffer_index += write;
     }
-    char* data = (char*)alloca(19);
-    int pos = _parse_int_mag(val, data, 18);
-    n += _print_buffer(&(data[pos]), 19 - pos);
-    return n;
+    if(write < count)
+    {
+        _count_truncated(ctx, count - write);
+    }
+    ctx->utf8_length += count;
 }
 
 /*
- * Parses a 64 bit unsigned integer and prints each character and returns the number of characters printed
- * For 32 bit unsigned integers, can convert to a 64 bit unsigned integer
+ * Stdout sink functions
+ * uses stdlib as an example but this would be implementation dependent in reality
+ * stdout takes UTF-8 bytes, so unicode chars are encoded
 */
-int print_unsigned_int(uint64_t val)
+void _stdout_put_chars(void* data, const char* str, int len)
 {
-    int n = 0;
-    if(val == 0)
+    (void)data;
+    fwrite(str, 1, len, stdout);
+}
+
+void _stdout_put_code(void* data, int code)
+{
+    (void)data;
+    char bytes[4];
+    int len = encode_char(code, bytes);
+    if(len == 0)
     {
-        put_char('0');
-        n++;
-        return n;
+        bytes[0] = '?';
+        len = 1;
     }
-    char* data = (char*)alloca(20);
-    int pos = _parse_int_mag(val, data, 19);
-    n += _print_buffer(&(data[pos]), 20 - pos);
-    return n;
+    fwrite(bytes, 1, len, stdout);
 }
 
-/*
- * Parses a 64 bit unsigned integer and prints each character in binary format and returns the number of
- * characters printed
- * For 32 bit unsigned integers, can convert to a 64 bit unsigned integer
-*/
-int print_bin(uint64_t val)
+void _stdout_put_fill(void* data, char c, int count)
 {
-    int n = 0;
-    put_char('0');
-    n++;
-    put_char('b');
-    n++;
-    if(val == 0)
+    (void)data;
+    char block[64];
+    memset(block, c, sizeof(block));
+    while(count > 0)
     {
-        put_char('0');
-        n++;
-        return n;
+        int len = count < (int)sizeof(block) ? count : (int)sizeof(block);
+        fwrite(block, 1, len, stdout);
+        count -= len;
     }
-    char* data = (char*)alloca(64);
-    int pos = _parse_bin_mag(val, data, 63);
-    n += _print_buffer(&(data[pos]), 64 - pos);
-    return n;
 }
 
+const printf_sink stdout_sink = {
+    .put_chars = _stdout_put_chars,
+    .put_code = _stdout_put_code,
+    .put_fill = _stdout_put_fill,
+    .put_ref = NULL,
+    .data = NULL
+};
+
 /*
- * Parses a 64 bit unsigned integer and prints each character in octal format and returns the number of
- * characters printed
- * For 32 bit unsigned integers, can convert to a 64 bit unsigned integer
+ * Sets up ctx to write to buffer, which holds up to size unicode chars
+ * Once the buffer is full, any further chars are dropped
 */
-int print_oct(uint64_t val)
+void printf_ctx_init_buffer(printf_ctx* ctx, int* buffer, int size)
 {
-    int n = 0;
-    put_char('0');
-    n++;
-    put_char('o');
-    n++;
-    if(val == 0)
-    {
-        put_char('0');
-        n++;
-        return n;
-    }
-    char* data = (char*)alloca(22);
-    int pos = _parse_oct_mag(val, data, 21);
-    n += _print_buffer(&(data[pos]), 22 - pos);
-    return n;
+    ctx->sink.put_chars = _buffer_put_chars;
+    ctx->sink.put_code = _buffer_put_code;
+    ctx->sink.put_fill = _buffer_put_fill;
+    ctx->sink.put_ref = NULL;
+    ctx->sink.data = ctx;
+    ctx->buffer = buffer;
+    ctx->utf8_buffer = NULL;
+    ctx->buffer_size = size;
+    ctx->buffer_index = 0;
+    ctx->utf8_length = 0;
+    ctx->utf8 = 0;
+    ctx->cache = NULL;
+    ctx->stats = NULL;
+    ctx->sig_figs = PRINTF_SIG_FIGS;
 }
 
 /*
- * Parses a 64 bit unsigned integer and prints each character in hexadecimal format and returns the number of
- * characters printed
- * For 32 bit unsigned integers, can convert to a 64 bit unsigned integer
+ * Sets up ctx to write UTF-8 to buffer, which holds up to size bytes
+ * Valid UTF-8 in strings and the format string is copied straight in, so a char takes 1 to 4 bytes rather than
+ * the 4 of a unicode char buffer
+ * Once a char doesn't fit, it and any further chars are dropped (but still counted in utf8_length)
 */
-int print_hex(uint64_t val)
+void printf_ctx_init_utf8_buffer(printf_ctx* ctx, char* buffer, int size)
 {
-    int n = 0;
-    put_char('0');
-    n++;
-    put_char('x');
-    n++;
-    if(val == 0)
-    {
-        put_char('0');
-        n++;
-        return n;
-    }
-    char* data = (char*)alloca(16);
-    int pos = _parse_hex_mag(val, data, 15);
-    n += _print_buffer(&(data[pos]), 16 - pos);
-    return n;
+    ctx->sink.put_chars = _utf8_buffer_put_chars;
+    ctx->sink.put_code = _utf8_buffer_put_code;
+    ctx->sink.put_fill = _utf8_buffer_put_fill;
+    ctx->sink.put_ref = NULL;
+    ctx->sink.data = ctx;
+    ctx->buffer = NULL;
+    ctx->utf8_buffer = buffer;
+    ctx->buffer_size = size;
+    ctx->buffer_index = 0;
+    ctx->utf8_length = 0;
+    ctx->utf8 = 1;
+    ctx->cache = NULL;
+    ctx->stats = NULL;
+    ctx->sig_figs = PRINTF_SIG_FIGS;
 }
 
 /*
- * Takes the bits of a float and checks if they are a special case of NaN or INF or 0
- * If they are they are printed
- * Otherwise, the float is decoded and returned as dec
- * If the number is negative its minus sign will also be printed
- * The value returned is whether more characters need printing or not
- * If returned value != 0, dec holds mantissa and exponent and work should be done on printing it in the desired format
- * If returned value == 0, all characters are printed
- * n is a pointer to a variable holding the number of characters printed
+ * Sets up ctx to write to sink
+ * The sink is given unicode chars, set ctx->utf8 afterwards if it takes UTF-8 bytes
 */
-int decode_float(double val, int* n, floating_decimal_64* dec)
+void printf_ctx_init_sink(printf_ctx* ctx, const printf_sink* sink)
 {
-    uint64_t float_bits = *(uint64_t*)&val;
-    uint8_t sign = float_bits >> (FLOAT_MANTISSA_BITS + FLOAT_EXP_BITS);
-    uint32_t exp = (float_bits >> FLOAT_MANTISSA_BITS) & FLOAT_EXP_MASK;
-    uint64_t man = float_bits & FLOAT_MANTISSA_MASK;
-    
-    if(sign)
+    ctx->sink = *sink;
+    ctx->buffer = NULL;
+    ctx->utf8_buffer = NULL;
+    ctx->buffer_size = 0;
+    ctx->buffer_index = 0;
+    ctx->utf8_length = 0;
+    ctx->utf8 = 0;
+    ctx->cache = NULL;
+    ctx->stats = NULL;
+    ctx->sig_figs = PRINTF_SIG_FIGS;
+}
+
+/*
+ * Context used by printf
+ * This is the only shared state and is only used by printf, yaos_vprintf, set_buffer and set_sink
+*/
+printf_ctx stdout_ctx = {
+    .sink = {
+        .put_chars = _stdout_put_chars,
+        .put_code = _stdout_put_code,
+        .put_fill = _stdout_put_fill,
+        .put_ref = NULL,
+        .data = NULL
+    },
+    .buffer = NULL,
+    .utf8_buffer = NULL,
+    .buffer_size = 0,
+    .buffer_index = 0,
+    .utf8_length = 0,
+    .utf8 = 1,
+    .cache = NULL,
+    .stats = NULL,
+    .sig_figs = PRINTF_SIG_FIGS
+};
+
+#ifdef TEST
+void set_buffer(int* stdout_buffer, int size)
+{
+    printf_cache* cache = stdout_ctx.cache;
+    printf_stats* stats = stdout_ctx.stats;
+    int sig_figs = stdout_ctx.sig_figs;
+    if(stdout_buffer != NULL && size > 0)
     {
-        put_char('-');
-        (*n)++;
+        printf_ctx_init_buffer(&stdout_ctx, stdout_buffer, size);
     }
-
-    // NaN -> exp == 0xff and man != 0
-    if(exp == FLOAT_EXP_MASK && man != 0)
+    else
     {
-        put_char('N');
-        (*n)++;
-        put_char('a');
-        (*n)++;
-        put_char('N');
-        (*n)++;
-        return 0;
+        printf_ctx_init_sink(&stdout_ctx, &stdout_sink);
+        stdout_ctx.utf8 = 1;
     }
+    stdout_ctx.cache = cache;
+    stdout_ctx.stats = stats;
+    stdout_ctx.sig_figs = sig_figs;
+}
+#endif
 
-    // INF -> exp == 0xff and man == 0
-    if(exp == FLOAT_EXP_MASK)
+void set_sink(const printf_sink* new_sink)
+{
+    printf_cache* cache = stdout_ctx.cache;
+    printf_stats* stats = stdout_ctx.stats;
+    int sig_figs = stdout_ctx.sig_figs;
+    printf_ctx_init_sink(&stdout_ctx, new_sink != NULL ? new_sink : &stdout_sink);
+    stdout_ctx.utf8 = new_sink == NULL;
+    stdout_ctx.cache = cache;
+    stdout_ctx.stats = stats;
+    stdout_ctx.sig_figs = sig_figs;
+}
+
+void set_cache(printf_cache* cache)
+{
+    stdout_ctx.cache = cache;
+}
+
+void set_stats(printf_stats* stats)
+{
+    stdout_ctx.stats = stats;
+}
+
+void set_sig_figs(int sig_figs)
+{
+    stdout_ctx.sig_figs = sig_figs;
+}
+
+printf_ctx* get_stdout_ctx(void)
+{
+    return &stdout_ctx;
+}
+
+/*
+ * Internal function
+ * Returns the tick count the latency histogram of a printf_stats is kept in
+*/
+uint64_t _stats_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+/*
+ * Internal function
+ * Counts a call which printed num chars, taking ticks since start, in stats
+*/
+void _count_call(printf_stats* stats, int num, uint64_t start)
+{
+    uint64_t ticks = _stats_ticks() - start;
+    int bucket = ticks == 0 ? 0 : 64 - __builtin_clzll(ticks);
+    if(bucket >= PRINTF_STATS_BUCKETS)
     {
-        //man == 0 or else is NaN
-        put_char('I');
-        (*n)++;
-        put_char('N');
-        (*n)++;
-        put_char('F');
-        (*n)++;
-        return 0;
+        bucket = PRINTF_STATS_BUCKETS - 1;
     }
-    
-    // handle case number is 0. Also do sign so can see if it's +/- 0
-    if(man == 0 && exp == 0)
+    stats->calls++;
+    stats->chars += num;
+    stats->latency[bucket]++;
+}
+
+/*
+ * Internal function
+ * Returns the index of the conversion conv in PRINTF_STATS_CONVS, or -1 if it isn't counted
+*/
+int _stats_conv_index(char conv)
+{
+    const char* found = conv != 0 ? strchr(PRINTF_STATS_CONVS, conv) : NULL;
+    return found != NULL ? found - PRINTF_STATS_CONVS : -1;
+}
+
+/*
+ * Internal function
+ * Counts a value formatted with the conversion conv which printed num chars in stats
+*/
+void _count_conv(printf_stats* stats, char conv, int num)
+{
+    int index = _stats_conv_index(conv);
+    if(index >= 0)
     {
-        put_char('0');
-        (*n)++;
-        return 0;
+        stats->conv_calls[index]++;
+        stats->conv_chars[index] += num;
     }
-    
-    *dec = d2d(man, exp);
+}
 
-    return 1;
+/*
+ * Clears stats
+*/
+void printf_stats_init(printf_stats* stats)
+{
+    memset(stats, 0, sizeof(printf_stats));
 }
 
+/*
+ * Returns the number of values formatted with the conversion conv (one of PRINTF_STATS_CONVS)
+*/
+uint64_t printf_stats_conv_calls(const printf_stats* stats, char conv)
+{
+    int index = _stats_conv_index(conv);
+    return index >= 0 ? stats->conv_calls[index] : 0;
+}
 
+/*
+ * Returns the number of chars printed by values formatted with the conversion conv (one of PRINTF_STATS_CONVS)
+*/
+uint64_t printf_stats_conv_chars(const printf_stats* stats, char conv)
+{
+    int index = _stats_conv_index(conv);
+    return index >= 0 ? stats->conv_chars[index] : 0;
+}
 
 /*
- * Rounds a 64 bit floating decimal number so that it's below FLOAT_MAX_MAN
- * FLOAT_MAX_MAN is used to determine the number of sig figs the floating point number is rounded to
- * It should be 1 more than the largest integer which has that many sig figs
+ * Returns the number of ticks at least percent percent of calls took no longer than, rounded up to the top of
+ * their histogram bucket (so within a factor of 2)
+ * Returns 0 if no calls have been counted
 */
-void round_float(floating_decimal_64* dec)
+uint64_t printf_stats_latency(const printf_stats* stats, int percent)
 {
-    uint64_t frac = 0;
-    while(dec->mantissa >= FLOAT_MAX_MAN * 10)
+    if(stats->calls == 0)
     {
-        uint64_t rem = dec->mantissa % 10;
-        frac = frac * 10 + rem;
-        dec->mantissa /= 10;
-        dec->exponent += 1;
+        return 0;
     }
-    if(dec->mantissa >= FLOAT_MAX_MAN)
+    // rank of the call wanted, rounded up so 100 percent is the slowest call
+    uint64_t rank = (stats->calls * (percent > 100 ? 100 : percent) + 99) / 100;
+    uint64_t seen = 0;
+    int bucket = 0;
+    for(; bucket < PRINTF_STATS_BUCKETS - 1; bucket++)
     {
-        uint64_t rem = dec->mantissa % 10;
-        dec->mantissa /= 10;
-        dec->exponent += 1;
-        if(rem > 5 || (rem == 5 && (dec->mantissa & 1) == 1)) // round to nearest even if have digit 5
+        seen += stats->latency[bucket];
+        if(seen >= rank)
         {
-            dec->mantissa++;
+            break;
         }
     }
+    return bucket == 0 ? 0 : ((uint64_t)1 << bucket) - 1;
 }
 
 /*
- * Parses a 64 bit floating point number (using Ryu) and prints it out in long format and returns the number of
- * characters printed
- * For 32 bit floating point numbers, can cast to double
- * The number of digits printed is the shortest length decimal representation of the floating point number
- * It prints the float to FLOAT_SIG_FIG significant figures
- * For the 6th sig fig digit, if > 5 rounds up, < 5 rounds down and = 5, rounds to nearest even
+ * Prints a report of stats to ctx: the totals, each conversion used and the median, 99th percentile and slowest
+ * latency buckets
+ * Returns the number of chars printed
 */
-int print_float(double val)
+int printf_stats_print(printf_ctx* ctx, const printf_stats* stats)
 {
-    int n = 0;
-    floating_decimal_64 dec;
-    if(decode_float(val, &n, &dec) == 0)
+    int num = yaos_format(ctx, "calls %lu chars %lu truncated %lu invalid utf-8 %lu\n", stats->calls,
+        stats->chars, stats->truncated, stats->invalid_utf8);
+    for(int i = 0; i < PRINTF_STATS_NUM_CONVS; i++)
     {
-        return n;
+        if(stats->conv_calls[i] > 0)
+        {
+            num += yaos_format(ctx, "%%%c calls %lu chars %lu\n", PRINTF_STATS_CONVS[i], stats->conv_calls[i],
+                stats->conv_chars[i]);
+        }
     }
+    num += yaos_format(ctx, "latency p50 %lu p99 %lu max %lu ticks\n", printf_stats_latency(stats, 50),
+        printf_stats_latency(stats, 99), printf_stats_latency(stats, 100));
+    return num;
+}
 
-    round_float(&dec);
+/*
+ * prints a unicode char to the sink
+*/
+void put_char(printf_ctx* ctx, int c)
+{
+    ctx->sink.put_code(ctx->sink.data, c);
+}
 
-    if(dec.exponent > 0) // essentially mantissa and enough zeroes to offset everything to correct place
+/*
+ * prints a run of len ascii chars to the sink
+*/
+void put_chars(printf_ctx* ctx, const char* str, int len)
+{
+    if(len > 0)
     {
-        n += print_unsigned_int(dec.mantissa);
-        while(dec.exponent > 0)
-        {
-            put_char('0');
-            n++;
-            dec.exponent -= 1;
-        }
+        ctx->sink.put_chars(ctx->sink.data, str, len);
     }
-    else
+}
+
+/*
+ * prints len bytes which stay valid until the end of the format call (the format string's text or a %s
+ * argument) to the sink, letting it keep a reference to them if it takes one
+*/
+void put_ref(printf_ctx* ctx, const char* str, int len)
+{
+    if(len > 0)
     {
-        char* data = (char*)alloca(20);
-        int pos = _parse_int_mag(dec.mantissa, data, 19);
-        int length = 20 - pos;
-        int index = length + dec.exponent - 1;
-        // printing floats with no integer part
-        if(index < 0)
+        if(ctx->sink.put_ref != NULL)
         {
-            put_char('0');
-            n++;
-            put_char('.');
-            n++;
-            for(int i = 0; i < -index - 1; i++)
-            {
-                put_char('0');
-                n++;
-            }
-            for(int j = 0; j < length; j++)
-            {
-                put_char(data[pos]);
-                pos++;
-                n++;
-            }
+            ctx->sink.put_ref(ctx->sink.data, str, len);
         }
         else
         {
-            // put out all digits before decimal point
-            int j = 0;
-            int first_length = index + 1; // calculate number of digits before decimal point
-            for(; j < first_length; j++)
-            {
-                put_char(data[pos]);
-                pos++;
-                n++;
-            }
-            // check if need decimal point and print it and remainder of digits if do
-            if(j < length)
-            {
-                put_char('.');
-                n++;
-                for(; j < length; j++)
-                {
-                    put_char(data[pos]);
-                    pos++;
-                    n++;
-                }
-            }
+            ctx->sink.put_chars(ctx->sink.data, str, len);
         }
     }
-
-    return n;
 }
 
 /*
- * Parses a 64 bit floating point number (using Ryu) and prints it out in scientific notation and returns the number of
- * characters printed
- * For 32 bit floating point numbers can cast to double 
- * The number of digits printed is the shortest length scientific representation of the floating point number
- * It prints the float to FLOAT_SIG_FIG significant figures
+ * prints the ascii char c count times to the sink
 */
-int print_float_scientific(double val)
+void put_fill(printf_ctx* ctx, char c, int count)
 {
-    int n = 0;
-    floating_decimal_64 dec;
-    if(decode_float(val, &n, &dec) == 0)
+    if(count > 0)
     {
-        // correct the printing for val == 0
-        if(val == 0)
-        {
-            put_char('e');
-            put_char('0');
-        }
-        return n;
+        ctx->sink.put_fill(ctx->sink.data, c, count);
     }
-    round_float(&dec);
-    char* data = (char*)alloca(20);
-    int pos = _parse_int_mag(dec.mantissa, data, 19);
-    int length = 20 - pos;
-    dec.exponent += length - 1;
+}
 
-    // shouldn't be 0 but better to be safe
-    if(length != 0)
-    {
-        put_char(data[pos]);
-        pos++;
-        n++;
-        // have more than 1 digit
-        if(length > 1)
-        {
-            put_char('.');
-            n++;
-        }
-    }
-    for(; pos < 20; pos++)
-    {
-        put_char(data[pos]);
-        n++;
-    }
-    put_char('e');
-    n++;
-    print_int((int64_t)dec.exponent);
+/*
+ * Internal function
+ * Prints internal ascii char buffer of known length
+ * Returns number of characters printed
+*/
+int _print_buffer(printf_ctx* ctx, const char* buffer, int len)
+{
+    put_chars(ctx, buffer, len);
+    return len;
+}
 
-    return n;
+/*
+ * Internal function
+ * Prints a run of len ascii chars from the format string or a %s argument, which the sink may keep a reference to
+ * Returns number of characters printed
+*/
+int _print_ref(printf_ctx* ctx, const char* str, int len)
+{
+    put_ref(ctx, str, len);
+    return len;
 }
 
 /*
- * Decodes a UTF-8 char from str and returns the number of bytes it holds
- * code is the Unicode character code of the UTF-8 bytes
- * If the char is not in UTF-8 format, returns 0 and *code is 0
+ * Internal function
+ * Starts a field of len chars padded to spec->width, printing the padding in front of it (unless it is left
+ * aligned) and the prefix_len chars of prefix the field starts with (its sign or base prefix)
+ * Zero fill goes between the prefix and the rest of the field, if zero is set and the '0' flag was given
+ * The padding is worked out from len before the rest of the field is printed, and is put out as a single fill
+ * Returns the number of characters printed
 */
-int decode_char(const char* str, int* code)
+int _pad_start(printf_ctx* ctx, const printf_spec* spec, const char* prefix, int prefix_len, int len, int zero)
 {
-    *code = 0;
-    int temp_code = 0; // used in process of building char
+    int pad = spec->width - len;
+    if(pad <= 0 || (spec->flags & PRINTF_FLAG_LEFT) != 0)
+    {
+        return _print_buffer(ctx, prefix, prefix_len);
+    }
+    if(zero && (spec->flags & PRINTF_FLAG_ZERO) != 0)
+    {
+        put_chars(ctx, prefix, prefix_len);
+        put_fill(ctx, '0', pad);
+    }
+    else
+    {
+        put_fill(ctx, ' ', pad);
+        put_chars(ctx, prefix, prefix_len);
+    }
+    return pad + prefix_len;
+}
+
+/*
+ * Internal function
+ * Ends a field of len chars started by _pad_start, printing the padding after it if it is left aligned
+ * Returns the number of characters printed
+*/
+int _pad_end(printf_ctx* ctx, const printf_spec* spec, int len)
+{
+    int pad = spec->width - len;
+    if(pad <= 0 || (spec->flags & PRINTF_FLAG_LEFT) == 0)
+    {
+        return 0;
+    }
+    put_fill(ctx, ' ', pad);
+    return pad;
+}
+
+/*
+ * Internal function
+ * Prints the len chars of buffer padded to spec->width, the first prefix_len of which are its sign or base prefix
+ * Returns the number of characters printed
+*/
+int _print_field(printf_ctx* ctx, const printf_spec* spec, const char* buffer, int len, int prefix_len, int zero)
+{
+    int n = _pad_start(ctx, spec, buffer, prefix_len, len, zero);
+    n += _print_buffer(ctx, &(buffer[prefix_len]), len - prefix_len);
+    return n + _pad_end(ctx, spec, len);
+}
+
+// pairs of decimal digits for 00 to 99 so two digits can be produced by each division
+const char DIGIT_PAIRS[200] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// powers of 10 which fit in a 64 bit unsigned integer
+const uint64_t POW10[20] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull,
+    1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull,
+    100000000000000ull, 1000000000000000ull, 10000000000000000ull, 100000000000000000ull,
+    1000000000000000000ull, 10000000000000000000ull
+};
+
+/*
+ * Internal function
+ * Returns the number of decimal digits in val (1 for val == 0)
+ * The bit length gives an estimate of log10 which is then corrected with a single table lookup
+*/
+int _decimal_length(uint64_t val)
+{
+    val |= 1; // doesn't change the number of digits but stops val == 0 having 0 digits
+    int bits = 64 - __builtin_clzll(val);
+    int estimate = (bits * 1233) >> 12; // 1233 / 4096 ~= log10(2)
+    return estimate + (estimate < 20 && val >= POW10[estimate]);
+}
+
+/*
+ * Internal function
+ * Writes exactly len decimal digits of val to buffer, front padded with '0' if val has fewer digits
+ * val must be < 10 ^ len
+ * Digits are written two at a time, with blocks of 8 digits split off first so the rest uses 32 bit division
+*/
+void _write_int_mag(uint64_t val, char* buffer, int len)
+{
+    while(val >> 32 != 0)
+    {
+        uint64_t q = val / 100000000;
+        uint32_t block = (uint32_t)(val - q * 100000000);
+        val = q;
+        for(int i = 0; i < 4; i++)
+        {
+            uint32_t r = block % 100;
+            block /= 100;
+            len -= 2;
+            memcpy(&(buffer[len]), &(DIGIT_PAIRS[r * 2]), 2);
+        }
+    }
+    uint32_t v = (uint32_t)val;
+    while(len >= 2)
+    {
+        uint32_t r = v % 100;
+        v /= 100;
+        len -= 2;
+        memcpy(&(buffer[len]), &(DIGIT_PAIRS[r * 2]), 2);
+    }
+    if(len == 1)
+    {
+        buffer[0] = v + '0';
+    }
+}
+
+// pairs of hex digits for 00 to ff so each byte is converted with a single lookup
+const char HEX_PAIRS[512] =
+    "000102030405060708090a0b0c0d0e0f"
+    "101112131415161718191a1b1c1d1e1f"
+    "202122232425262728292a2b2c2d2e2f"
+    "303132333435363738393a3b3c3d3e3f"
+    "404142434445464748494a4b4c4d4e4f"
+    "505152535455565758595a5b5c5d5e5f"
+    "606162636465666768696a6b6c6d6e6f"
+    "707172737475767778797a7b7c7d7e7f"
+    "808182838485868788898a8b8c8d8e8f"
+    "909192939495969798999a9b9c9d9e9f"
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf"
+    "b0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+    "c0c1c2c3c4c5c6c7c8c9cacbcccdcecf"
+    "d0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+    "e0e1e2e3e4e5e6e7e8e9eaebecedeeef"
+    "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+// pairs of octal digits for 00 to 77 so each 6 bits are converted with a single lookup
+const char OCT_PAIRS[128] =
+    "00010203040506071011121314151617"
+    "20212223242526273031323334353637"
+    "40414243444546475051525354555657"
+    "60616263646566677071727374757677";
+
+/*
+ * Internal function
+ * Returns the number of significant bits in val (1 for val == 0)
+*/
+int _bit_length(uint64_t val)
+{
+    return 64 - __builtin_clzll(val | 1);
+}
+
+/*
+ * Internal function
+ * Writes the 8 bits of byte to buffer as 8 binary digits, most significant first
+ * Each bit is moved into its own byte with a multiply and mask so there is no loop over the bits
+*/
+void _write_bin_byte(uint8_t byte, char* buffer)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    const uint64_t select = 0x0102040810204080ull; // lowest byte in memory gets the highest bit
+#else
+    const uint64_t select = 0x8040201008040201ull;
+#endif
+    uint64_t bits = (byte * 0x0101010101010101ull) & select;
+    // any set bit in a byte carries into bit 7 of that byte
+    bits = ((bits + 0x7f7f7f7f7f7f7f7full) >> 7) & 0x0101010101010101ull;
+    bits |= 0x3030303030303030ull; // '0' or '1'
+    memcpy(buffer, &bits, 8);
+}
+
+/*
+ * Internal function
+ * Writes exactly len binary digits of val to buffer, front padded with '0' if val has fewer digits
+ * The digits are written a byte of val at a time from the end of the buffer
+*/
+void _write_bin_mag(uint64_t val, char* buffer, int len)
+{
+    while(len >= 8)
+    {
+        len -= 8;
+        _write_bin_byte(val & 0xff, &(buffer[len]));
+        val >>= 8;
+    }
+    if(len > 0)
+    {
+        char last[8];
+        _write_bin_byte(val & 0xff, last);
+        memcpy(buffer, &(last[8 - len]), len);
+    }
+}
+
+/*
+ * Internal function
+ * Writes exactly len octal digits of val to buffer, front padded with '0' if val has fewer digits
+*/
+void _write_oct_mag(uint64_t val, char* buffer, int len)
+{
+    while(len >= 2)
+    {
+        len -= 2;
+        memcpy(&(buffer[len]), &(OCT_PAIRS[(val & 0x3f) * 2]), 2);
+        val >>= 6;
+    }
+    if(len == 1)
+    {
+        buffer[0] = (val & 7) + '0';
+    }
+}
+
+/*
+ * Internal function
+ * Writes exactly len hex digits of val to buffer, front padded with '0' if val has fewer digits
+*/
+void _write_hex_mag(uint64_t val, char* buffer, int len)
+{
+    while(len >= 2)
+    {
+        len -= 2;
+        memcpy(&(buffer[len]), &(HEX_PAIRS[(val & 0xff) * 2]), 2);
+        val >>= 8;
+    }
+    if(len == 1)
+    {
+        buffer[0] = HEX_PAIRS[(val & 0xf) * 2 + 1];
+    }
+}
+
+/*
+ * Writes a 64 bit signed integer in decimal to buffer, if it fits in size chars (PRINTF_INT_CHARS always fits)
+ * Returns the number of chars in the text (so the text was only written if it is <= size)
+ * The text isn't 0 terminated. This and the other to_chars functions write the same text printf would, without
+ * going through a printf_ctx, so encoders can write straight into their own buffers
+*/
+int int_to_chars(char* buffer, int size, int64_t val)
+{
+    int negative = val < 0;
+    uint64_t mag = negative ? 0 - (uint64_t)val : (uint64_t)val;
+    int length = _decimal_length(mag);
+    if(negative + length <= size)
+    {
+        if(negative)
+        {
+            buffer[0] = '-';
+        }
+        _write_int_mag(mag, &(buffer[negative]), length);
+    }
+    return negative + length;
+}
+
+/*
+ * Writes a 64 bit unsigned integer in decimal to buffer, if it fits in size chars (PRINTF_INT_CHARS always fits)
+ * Returns the number of chars in the text
+*/
+int unsigned_to_chars(char* buffer, int size, uint64_t val)
+{
+    int length = _decimal_length(val);
+    if(length <= size)
+    {
+        _write_int_mag(val, buffer, length);
+    }
+    return length;
+}
+
+/*
+ * Writes a 64 bit unsigned integer in binary (with 0b in front) to buffer, if it fits in size chars
+ * (PRINTF_BIN_CHARS always fits)
+ * Returns the number of chars in the text
+*/
+int bin_to_chars(char* buffer, int size, uint64_t val)
+{
+    int length = _bit_length(val);
+    if(length + 2 <= size)
+    {
+        buffer[0] = '0';
+        buffer[1] = 'b';
+        _write_bin_mag(val, &(buffer[2]), length);
+    }
+    return length + 2;
+}
+
+/*
+ * Writes a 64 bit unsigned integer in octal (with 0o in front) to buffer, if it fits in size chars
+ * (PRINTF_OCT_CHARS always fits)
+ * Returns the number of chars in the text
+*/
+int oct_to_chars(char* buffer, int size, uint64_t val)
+{
+    int length = (_bit_length(val) + 2) / 3;
+    if(length + 2 <= size)
+    {
+        buffer[0] = '0';
+        buffer[1] = 'o';
+        _write_oct_mag(val, &(buffer[2]), length);
+    }
+    return length + 2;
+}
+
+/*
+ * Writes a 64 bit unsigned integer in hexadecimal (with 0x in front) to buffer, if it fits in size chars
+ * (PRINTF_HEX_CHARS always fits)
+ * Returns the number of chars in the text
+*/
+int hex_to_chars(char* buffer, int size, uint64_t val)
+{
+    int length = (_bit_length(val) + 3) / 4;
+    if(length + 2 <= size)
+    {
+        buffer[0] = '0';
+        buffer[1] = 'x';
+        _write_hex_mag(val, &(buffer[2]), length);
+    }
+    return length + 2;
+}
+
+/*
+ * Parses a 64 bit signed integer and prints each character and returns the number of characters printed
+ * For 32 bit signed integers, can convert to a 64 bit signed integer and use this function
+*/
+int print_int(printf_ctx* ctx, int64_t val)
+{
+    char data[PRINTF_INT_CHARS];
+    return _print_buffer(ctx, data, int_to_chars(data, PRINTF_INT_CHARS, val));
+}
+
+/*
+ * Parses a 64 bit unsigned integer and prints each character and returns the number of characters printed
+ * For 32 bit unsigned integers, can convert to a 64 bit unsigned integer
+*/
+int print_unsigned_int(printf_ctx* ctx, uint64_t val)
+{
+    char data[PRINTF_INT_CHARS];
+    return _print_buffer(ctx, data, unsigned_to_chars(data, PRINTF_INT_CHARS, val));
+}
+
+/*
+ * Parses a 64 bit unsigned integer and prints each character in binary format and returns the number of
+ * characters printed
+ * For 32 bit unsigned integers, can convert to a 64 bit unsigned integer
+*/
+int print_bin(printf_ctx* ctx, uint64_t val)
+{
+    char data[PRINTF_BIN_CHARS];
+    return _print_buffer(ctx, data, bin_to_chars(data, PRINTF_BIN_CHARS, val));
+}
+
+/*
+ * Parses a 64 bit unsigned integer and prints each character in octal format and returns the number of
+ * characters printed
+ * For 32 bit unsigned integers, can convert to a 64 bit unsigned integer
+*/
+int print_oct(printf_ctx* ctx, uint64_t val)
+{
+    char data[PRINTF_OCT_CHARS];
+    return _print_buffer(ctx, data, oct_to_chars(data, PRINTF_OCT_CHARS, val));
+}
+
+/*
+ * Parses a 64 bit unsigned integer and prints each character in hexadecimal format and returns the number of
+ * characters printed
+ * For 32 bit unsigned integers, can convert to a 64 bit unsigned integer
+*/
+int print_hex(printf_ctx* ctx, uint64_t val)
+{
+    char data[PRINTF_HEX_CHARS];
+    return _print_buffer(ctx, data, hex_to_chars(data, PRINTF_HEX_CHARS, val));
+}
+
+/*
+ * Internal function
+ * Splits val into its sign and its mantissa and exponent bits
+ * Returns "NaN" or "INF" if val is one of them, otherwise NULL (including for 0)
+*/
+const char* _split_float(double val, int* negative, uint64_t* man, uint32_t* exp)
+{
+    uint64_t float_bits;
+    memcpy(&float_bits, &val, sizeof(double));
+    *negative = float_bits >> (FLOAT_MANTISSA_BITS + FLOAT_EXP_BITS);
+    *exp = (float_bits >> FLOAT_MANTISSA_BITS) & FLOAT_EXP_MASK;
+    *man = float_bits & FLOAT_MANTISSA_MASK;
+    if(*exp == FLOAT_EXP_MASK)
+    {
+        return *man != 0 ? "NaN" : "INF";
+    }
+    return NULL;
+}
+
+/*
+ * Internal function
+ * Takes the bits of a float and sets negative to its sign
+ * If it is a special case of NaN, INF or 0 its text is returned ("0e0" for 0 when scientific)
+ * Otherwise, the float is decoded into dec (with the engine chosen by PRINTF_FLOAT_ENGINE) and NULL is returned
+*/
+const char* _decode_float(double val, int scientific, int* negative, floating_decimal_64* dec)
+{
+    uint64_t float_bits;
+    memcpy(&float_bits, &val, sizeof(double));
+    uint32_t exp = (float_bits >> FLOAT_MANTISSA_BITS) & FLOAT_EXP_MASK;
+    uint64_t man = float_bits & FLOAT_MANTISSA_MASK;
+    *negative = float_bits >> (FLOAT_MANTISSA_BITS + FLOAT_EXP_BITS);
+    if(exp == FLOAT_EXP_MASK)
+    {
+        return man != 0 ? "NaN" : "INF";
+    }
+    // 0 still has its sign so +/- 0 can be told apart
+    if(man == 0 && exp == 0)
+    {
+        return scientific ? "0e0" : "0";
+    }
+    *dec = FLOAT_ENGINE_D2D(man, exp);
+    return NULL;
+}
+
+/*
+ * Internal function
+ * 32 bit version of _decode_float, using the 32 bit Ryu (f2d) so the float is never widened to a double
+ * The shortest digits of a float are fewer than those of the same value as a double (0.1f is 0.1 rather than
+ * 0.100000001490116)
+*/
+const char* _decode_float32(float val, int scientific, int* negative, floating_decimal_64* dec)
+{
+    uint32_t float_bits;
+    memcpy(&float_bits, &val, sizeof(float));
+    uint32_t exp = (float_bits >> FLOAT32_MANTISSA_BITS) & FLOAT32_EXP_MASK;
+    uint32_t man = float_bits & FLOAT32_MANTISSA_MASK;
+    *negative = float_bits >> (FLOAT32_MANTISSA_BITS + FLOAT32_EXP_BITS);
+    if(exp == FLOAT32_EXP_MASK)
+    {
+        return man != 0 ? "NaN" : "INF";
+    }
+    if(man == 0 && exp == 0)
+    {
+        return scientific ? "0e0" : "0";
+    }
+    floating_decimal_32 dec32 = f2d(man, exp);
+    dec->mantissa = dec32.mantissa;
+    dec->exponent = dec32.exponent;
+    return NULL;
+}
+
+/*
+ * Internal function
+ * Decodes a float to print to sig_figs significant figures, the same as _decode_float32 while its shortest digits
+ * need no rounding
+ * Otherwise the digits come from the float widened to a double, as rounding the shortest digits of the float would
+ * round twice: 2.34185f is 2.3418500423... which rounds up to 2.3419, but its shortest digits 2.34185 are a tie
+ * which rounds to even
+*/
+const char* _decode_float32_sig_figs(float val, int scientific, int sig_figs, int* negative, floating_decimal_64* dec)
+{
+    const char* special = _decode_float32(val, scientific, negative, dec);
+    if(special == NULL && sig_figs > PRINTF_SHORTEST && _decimal_length(dec->mantissa) > sig_figs)
+    {
+        special = _decode_float(val, scientific, negative, dec);
+    }
+    return special;
+}
+
+/*
+ * Rounds a 64 bit floating decimal number to sig_figs significant figures, rounding half to even
+ * The digits dropped are split off with a single division by a power of 10 and compared with half of it
+ * If sig_figs is PRINTF_SHORTEST (or the number already has few enough digits) it is left as the shortest
+ * digits which round trip
+*/
+void round_float(floating_decimal_64* dec, int sig_figs)
+{
+    int length = _decimal_length(dec->mantissa);
+    if(sig_figs <= PRINTF_SHORTEST || length <= sig_figs)
+    {
+        return;
+    }
+    int drop = length - sig_figs;
+    uint64_t div = POW10[drop];
+    uint64_t q = dec->mantissa / div;
+    uint64_t rem = dec->mantissa - q * div;
+    uint64_t half = div >> 1;
+    dec->exponent += drop;
+    if(rem > half || (rem == half && (q & 1) == 1))
+    {
+        q++;
+        // rounding up 99...9 gives an extra digit
+        if(q == POW10[sig_figs])
+        {
+            q = POW10[sig_figs - 1];
+            dec->exponent++;
+        }
+    }
+    dec->mantissa = q;
+}
+
+/*
+ * Internal function
+ * Returns the number of chars in the floating decimal dec in long format
+*/
+int _float_dec_length(floating_decimal_64 dec)
+{
+    int length = _decimal_length(dec.mantissa);
+    if(dec.exponent >= 0)
+    {
+        return length + dec.exponent;
+    }
+    int frac_length = -dec.exponent;
+    // floats with no integer part are 0. then the fraction
+    return frac_length >= length ? frac_length + 2 : length + 1;
+}
+
+/*
+ * Internal function
+ * Writes the floating decimal dec in long format to buffer, which holds _float_dec_length(dec) chars
+*/
+void _write_float_dec(floating_decimal_64 dec, char* buffer)
+{
+    int length = _decimal_length(dec.mantissa);
+    if(dec.exponent >= 0) // essentially mantissa and enough zeroes to offset everything to correct place
+    {
+        _write_int_mag(dec.mantissa, buffer, length);
+        memset(&(buffer[length]), '0', dec.exponent);
+        return;
+    }
+    int frac_length = -dec.exponent;
+    // printing floats with no integer part
+    if(frac_length >= length)
+    {
+        buffer[0] = '0';
+        buffer[1] = '.';
+        memset(&(buffer[2]), '0', frac_length - length);
+        _write_int_mag(dec.mantissa, &(buffer[2 + frac_length - length]), length);
+        return;
+    }
+    // split into the digits before and after the decimal point and write them either side of it
+    int first_length = length - frac_length;
+    uint64_t first = dec.mantissa / POW10[frac_length];
+    _write_int_mag(first, buffer, first_length);
+    buffer[first_length] = '.';
+    _write_int_mag(dec.mantissa - first * POW10[frac_length], &(buffer[first_length + 1]), frac_length);
+}
+
+/*
+ * Internal function
+ * Returns the number of chars in the floating decimal dec in scientific notation
+*/
+int _float_dec_scientific_length(floating_decimal_64 dec)
+{
+    int length = _decimal_length(dec.mantissa);
+    int exp = dec.exponent + length - 1;
+    uint32_t exp_mag = exp < 0 ? -exp : exp;
+    // digits, decimal point if more than 1 digit, e, exponent sign and exponent digits
+    return length + (length > 1) + 1 + (exp < 0) + _decimal_length(exp_mag);
+}
+
+/*
+ * Internal function
+ * Writes the floating decimal dec in scientific notation to buffer, which holds _float_dec_scientific_length(dec)
+ * chars
+*/
+void _write_float_dec_scientific(floating_decimal_64 dec, char* buffer)
+{
+    int length = _decimal_length(dec.mantissa);
+    int exp = dec.exponent + length - 1;
+
+    _write_int_mag(dec.mantissa, &(buffer[1]), length);
+    buffer[0] = buffer[1];
+    int pos = 1;
+    // have more than 1 digit
+    if(length > 1)
+    {
+        buffer[1] = '.';
+        pos = length + 1;
+    }
+    buffer[pos] = 'e';
+    pos++;
+    uint32_t exp_mag = exp;
+    if(exp < 0)
+    {
+        buffer[pos] = '-';
+        pos++;
+        exp_mag = -exp;
+    }
+    _write_int_mag(exp_mag, &(buffer[pos]), _decimal_length(exp_mag));
+}
+
+/*
+ * Internal function
+ * Writes a decoded float to buffer if it fits in size chars: its minus sign if negative, then special if it isn't
+ * NULL or else dec rounded to sig_figs significant figures in long or scientific format
+ * Returns the number of chars in the text
+*/
+int _float_chars(char* buffer, int size, int negative, const char* special, floating_decimal_64 dec, int sig_figs,
+    int scientific)
+{
+    int length;
+    if(special != NULL)
+    {
+        length = strlen(special);
+    }
+    else
+    {
+        round_float(&dec, sig_figs);
+        length = scientific ? _float_dec_scientific_length(dec) : _float_dec_length(dec);
+    }
+    if(negative + length > size)
+    {
+        return negative + length;
+    }
+    if(negative)
+    {
+        buffer[0] = '-';
+    }
+    if(special != NULL)
+    {
+        memcpy(&(buffer[negative]), special, length);
+    }
+    else if(scientific)
+    {
+        _write_float_dec_scientific(dec, &(buffer[negative]));
+    }
+    else
+    {
+        _write_float_dec(dec, &(buffer[negative]));
+    }
+    return negative + length;
+}
+
+/*
+ * Writes a 64 bit float in long format to buffer, if it fits in size chars (PRINTF_FLOAT_CHARS always fits)
+ * It is rounded to sig_figs significant figures, or PRINTF_SHORTEST for the shortest digits which round trip
+ * Returns the number of chars in the text
+*/
+int float_to_chars(char* buffer, int size, double val, int sig_figs)
+{
+    int negative;
+    floating_decimal_64 dec;
+    const char* special = _decode_float(val, 0, &negative, &dec);
+    return _float_chars(buffer, size, negative, special, dec, sig_figs, 0);
+}
+
+/*
+ * Writes a 64 bit float in scientific notation to buffer, if it fits in size chars (PRINTF_FLOAT_SCIENTIFIC_CHARS
+ * always fits)
+ * It is rounded to sig_figs significant figures, or PRINTF_SHORTEST for the shortest digits which round trip
+ * Returns the number of chars in the text
+*/
+int float_scientific_to_chars(char* buffer, int size, double val, int sig_figs)
+{
+    int negative;
+    floating_decimal_64 dec;
+    const char* special = _decode_float(val, 1, &negative, &dec);
+    return _float_chars(buffer, size, negative, special, dec, sig_figs, 1);
+}
+
+/*
+ * Parses a 64 bit floating point number (using Ryu) and prints it out in long format and returns the number of
+ * characters printed
+ * For 32 bit floating point numbers use print_float32, which skips widening to double
+ * The number of digits printed is the shortest length decimal representation of the floating point number
+ * It prints the float to ctx->sig_figs significant figures (or the shortest round trip digits), rounding half to even
+*/
+int print_float(printf_ctx* ctx, double val)
+{
+    char data[PRINTF_FLOAT_CHARS];
+    return _print_buffer(ctx, data, float_to_chars(data, PRINTF_FLOAT_CHARS, val, ctx->sig_figs));
+}
+
+/*
+ * Parses a 64 bit floating point number (using Ryu) and prints it out in scientific notation and returns the number of
+ * characters printed
+ * For 32 bit floating point numbers use print_float32_scientific, which skips widening to double
+ * The number of digits printed is the shortest length scientific representation of the floating point number
+ * It prints the float to ctx->sig_figs significant figures (or the shortest round trip digits)
+*/
+int print_float_scientific(printf_ctx* ctx, double val)
+{
+    char data[PRINTF_FLOAT_SCIENTIFIC_CHARS];
+    return _print_buffer(ctx, data, float_scientific_to_chars(data, PRINTF_FLOAT_SCIENTIFIC_CHARS, val,
+        ctx->sig_figs));
+}
+
+/*
+ * Prints a 32 bit floating point number in long format using the 32 bit Ryu and returns the number of characters
+ * printed
+ * Works the same as print_float, but the shortest digits are those of the float rather than of it widened to a double
+ * (digits rounded to ctx->sig_figs are still rounded from the exact value, so they match print_float)
+*/
+int print_float32(printf_ctx* ctx, float val)
+{
+    char data[PRINTF_FLOAT_CHARS];
+    int negative;
+    floating_decimal_64 dec;
+    const char* special = _decode_float32_sig_figs(val, 0, ctx->sig_figs, &negative, &dec);
+    return _print_buffer(ctx, data, _float_chars(data, PRINTF_FLOAT_CHARS, negative, special, dec, ctx->sig_figs, 0));
+}
+
+/*
+ * Prints a 32 bit floating point number in scientific notation using the 32 bit Ryu and returns the number of
+ * characters printed
+ * Works the same as print_float_scientific, but the shortest digits are those of the float
+*/
+int print_float32_scientific(printf_ctx* ctx, float val)
+{
+    char data[PRINTF_FLOAT_SCIENTIFIC_CHARS];
+    int negative;
+    floating_decimal_64 dec;
+    const char* special = _decode_float32_sig_figs(val, 1, ctx->sig_figs, &negative, &dec);
+    return _print_buffer(ctx, data, _float_chars(data, PRINTF_FLOAT_SCIENTIFIC_CHARS, negative, special, dec,
+        ctx->sig_figs, 1));
+}
+
+// max number of digits in the exact decimal expansion of a double
+// (309 integer digits, or up to 16 integer digits followed by up to 1074 fraction digits)
+#define FLOAT_MAX_DIGITS 1100
+// base of the limbs of the big integers used for exact float digits
+#define BIG_BASE 1000000000u
+// limbs needed to hold the largest big integer (a 53 bit fraction times 5 ^ 1074 is under 10 ^ 767)
+#define BIG_LIMBS 90
+
+// powers of 5 which fit in a 32 bit unsigned integer
+const uint32_t POW5[14] = {
+    1u, 5u, 25u, 125u, 625u, 3125u, 15625u, 78125u, 390625u, 1953125u, 9765625u, 48828125u, 244140625u,
+    1220703125u
+};
+
+/*
+ * Internal function
+ * Sets big to val (as base 10 ^ 9 limbs, least significant first) and returns the number of limbs
+*/
+int _big_set(uint32_t* big, uint64_t val)
+{
+    int len = 0;
+    do
+    {
+        big[len] = val % BIG_BASE;
+        val /= BIG_BASE;
+        len++;
+    } while(val != 0);
+    return len;
+}
+
+/*
+ * Internal function
+ * Multiplies the big integer of len limbs by mul and returns the new number of limbs
+*/
+int _big_mul(uint32_t* big, int len, uint32_t mul)
+{
+    uint64_t carry = 0;
+    for(int i = 0; i < len; i++)
+    {
+        uint64_t prod = (uint64_t)big[i] * mul + carry;
+        carry = prod / BIG_BASE;
+        big[i] = (uint32_t)(prod - carry * BIG_BASE);
+    }
+    while(carry != 0)
+    {
+        big[len] = carry % BIG_BASE;
+        carry /= BIG_BASE;
+        len++;
+    }
+    return len;
+}
+
+/*
+ * Internal function
+ * Returns the number of decimal digits in the big integer of len limbs
+*/
+int _big_length(const uint32_t* big, int len)
+{
+    return _decimal_length(big[len - 1]) + 9 * (len - 1);
+}
+
+/*
+ * Internal function
+ * Writes the decimal digits of the big integer of len limbs to digits
+*/
+void _big_write(const uint32_t* big, int len, char* digits)
+{
+    int top = _decimal_length(big[len - 1]);
+    _write_int_mag(big[len - 1], digits, top);
+    digits += top;
+    for(int i = len - 2; i >= 0; i--)
+    {
+        _write_int_mag(big[i], digits, 9);
+        digits += 9;
+    }
+}
+
+/*
+ * Internal function
+ * Divides the big integer of len limbs by 2 ^ shift, dropping the remainder, and returns the new number of limbs
+ * sticky is set to 1 if the remainder dropped isn't 0
+*/
+int _big_shift(uint32_t* big, int len, int shift, int* sticky)
+{
+    for(; shift > 0; shift -= 31)
+    {
+        int bits = shift < 31 ? shift : 31;
+        uint64_t rem = 0;
+        for(int i = len - 1; i >= 0; i--)
+        {
+            uint64_t cur = rem * BIG_BASE + big[i];
+            big[i] = (uint32_t)(cur >> bits);
+            rem = cur & ((1ull << bits) - 1);
+        }
+        *sticky |= rem != 0;
+        while(len > 1 && big[len - 1] == 0)
+        {
+            len--;
+        }
+    }
+    return len;
+}
+
+/*
+ * Internal function
+ * Sets q to f * 10 ^ m / 2 ^ k rounded down (for 0 < f < 2 ^ k and m < k) if it fits in 64 bits, and sticky to 1
+ * if anything was rounded off
+ * Returns 1 if q fits or 0 if it doesn't
+ * f * 5 ^ m is made in binary, so dividing it by 2 ^ (k - m) just takes its top bits, and since 5 ^ m is odd
+ * something is rounded off only when f has fewer than k - m trailing zero bits
+*/
+int _frac_scaled(uint64_t f, int k, int m, uint64_t* q, int* sticky)
+{
+    uint32_t bin[BIG_LIMBS];
+    bin[0] = (uint32_t)f;
+    bin[1] = (uint32_t)(f >> 32);
+    int len = bin[1] != 0 ? 2 : 1;
+    for(int i = m; i > 0; i -= 13)
+    {
+        uint32_t mul = POW5[i < 13 ? i : 13];
+        uint64_t carry = 0;
+        for(int j = 0; j < len; j++)
+        {
+            uint64_t prod = (uint64_t)bin[j] * mul + carry;
+            bin[j] = (uint32_t)prod;
+            carry = prod >> 32;
+        }
+        if(carry != 0)
+        {
+            bin[len] = (uint32_t)carry;
+            len++;
+        }
+    }
+    int shift = k - m;
+    int word = shift / 32;
+    int bit = shift % 32;
+    // the bits from shift up are in at most 3 limbs, and only fit in 64 bits if those in the third are shifted out
+    if(len > word + 3)
+    {
+        return 0;
+    }
+    uint64_t low = word < len ? bin[word] : 0;
+    low |= word + 1 < len ? (uint64_t)bin[word + 1] << 32 : 0;
+    uint64_t high = word + 2 < len ? bin[word + 2] : 0;
+    if((high >> bit) != 0)
+    {
+        return 0;
+    }
+    *q = bit == 0 ? low : (low >> bit) | (high << (64 - bit));
+    *sticky = shift > __builtin_ctzll(f);
+    return 1;
+}
+
+/*
+ * Internal function
+ * Writes the decimal digits of man * 2 ^ exp (man != 0) to digits, with no leading zeros before the decimal
+ * point but keeping those after it, and at most max_frac (> 0) digits after it
+ * If any non-zero digits are cut off past max_frac, a '1' is written in their place so rounding still sees them
+ * Returns the number of digits written and sets point to how many of them are before the decimal point
+ *
+ * The digits are exact: the integer part is man shifted up as a big integer and the fraction f / 2 ^ k is
+ * written as the k digits of f * 5 ^ k
+ * When k > max_frac only the first max_frac digits are made, as f * 5 ^ max_frac / 2 ^ (k - max_frac), which
+ * keeps the big integer small for tiny values printed to a few digits (and when those digits fit in 64 bits,
+ * f * 5 ^ max_frac is made in binary so the division is just a shift)
+*/
+int _exact_digits(uint64_t man, int exp, int max_frac, char* digits, int* point)
+{
+    uint32_t big[BIG_LIMBS];
+    if(exp >= 0)
+    {
+        int len = _big_set(big, man);
+        for(; exp > 0; exp -= 31)
+        {
+            len = _big_mul(big, len, 1u << (exp < 31 ? exp : 31));
+        }
+        *point = _big_length(big, len);
+        _big_write(big, len, digits);
+        return *point;
+    }
+
+    int k = -exp;
+    uint64_t int_part = k < 64 ? man >> k : 0;
+    uint64_t frac = k < 64 ? man & ((1ull << k) - 1) : man;
+    int n = 0;
+    if(int_part != 0)
+    {
+        n = _decimal_length(int_part);
+        _write_int_mag(int_part, digits, n);
+    }
+    *point = n;
+    if(frac == 0)
+    {
+        return n;
+    }
+
+    int frac_digits = k < max_frac ? k : max_frac;
+    int sticky = 0;
+    uint64_t q;
+    if(k > max_frac && _frac_scaled(frac, k, max_frac, &q, &sticky))
+    {
+        int q_length = _decimal_length(q);
+        memset(&(digits[n]), '0', frac_digits - q_length);
+        _write_int_mag(q, &(digits[n + frac_digits - q_length]), q_length);
+    }
+    else
+    {
+        int len = _big_set(big, frac);
+        for(int i = frac_digits; i > 0; i -= 13)
+        {
+            len = _big_mul(big, len, POW5[i < 13 ? i : 13]);
+        }
+        len = _big_shift(big, len, k - frac_digits, &sticky);
+        // f * 5 ^ k < 10 ^ k (and scaled down, under 10 ^ max_frac) so it is front padded with zeros
+        int frac_length = _big_length(big, len);
+        memset(&(digits[n]), '0', frac_digits - frac_length);
+        _big_write(big, len, &(digits[n + frac_digits - frac_length]));
+    }
+    n += frac_digits;
+    if(sticky)
+    {
+        digits[n] = '1';
+        n++;
+    }
+    return n;
+}
+
+/*
+ * Internal function
+ * Returns 1 if man * 2 ^ exp (man != 0) is certainly under half of 10 ^ -prec, so it rounds to 0 with prec
+ * digits after the decimal point
+ * The value is under 2 ^ (exp + bits of man), which is at most half of 10 ^ -prec when that exponent is at most
+ * -prec * log2(10) - 1 (and log2(10) < 3.322)
+*/
+int _rounds_to_zero(uint64_t man, int exp, int prec)
+{
+    int top = exp + _bit_length(man);
+    return (top + 1) * 1000 <= -3322 * prec;
+}
+
+/*
+ * Internal function
+ * Returns the number of digits after the decimal point _print_float_scientific_prec needs from _exact_digits for
+ * man * 2 ^ exp (man != 0): any leading zeros, then prec + 1 significant digits and one more to round with
+ * Leading zeros come before a value under 2 ^ top, and there are at most (1 - top) * log10(2) of them as the
+ * value is at least 2 ^ (top - 1)
+*/
+int _scientific_frac_digits(uint64_t man, int exp, int prec)
+{
+    int top = exp + _bit_length(man);
+    // 78913 / 2 ^ 18 is just under log10(2), so 1 is added for that as well as rounding down
+    int zeros = top <= 0 ? (((1 - top) * 78913) >> 18) + 1 : 0;
+    return zeros + prec + 2;
+}
+
+/*
+ * Internal function
+ * Rounds the len digits to keep digits, rounding half to even (digits past len are 0)
+ * Returns 1 if the rounding carried out of the first digit, in which case the kept digits are all '0' and
+ * a '1' needs to go in front of them
+*/
+int _round_digits(char* digits, int keep, int len)
+{
+    if(keep >= len)
+    {
+        return 0;
+    }
+    int up = digits[keep] > '5';
+    if(digits[keep] == '5')
+    {
+        // a tie only when every digit after the 5 is 0
+        up = keep > 0 && ((digits[keep - 1] - '0') & 1);
+        for(int i = keep + 1; i < len; i++)
+        {
+            if(digits[i] != '0')
+            {
+                up = 1;
+                break;
+            }
+        }
+    }
+    if(!up)
+    {
+        return 0;
+    }
+    for(int i = keep - 1; i >= 0; i--)
+    {
+        if(digits[i] != '9')
+        {
+            digits[i]++;
+            return 0;
+        }
+        digits[i] = '0';
+    }
+    return 1;
+}
+
+/*
+ * Internal function
+ * Converts the mantissa and exponent bits of a float to man and exp so its value is man * 2 ^ exp
+*/
+void _float_value(uint64_t* man, uint32_t bits_exp, int* exp)
+{
+    if(bits_exp == 0)
+    {
+        *exp = 1 - 1075; // subnormal
+    }
+    else
+    {
+        *man |= 1ull << FLOAT_MANTISSA_BITS;
+        *exp = (int)bits_exp - 1075;
+    }
+}
+
+#ifdef __SIZEOF_INT128__
+/*
+ * Internal function
+ * Writes man / 2 ^ k with prec digits after the decimal point to data for 0 < k <= 64 and prec < 20
+ * Returns the number of chars written (at most 41)
+ * The fraction is scaled by 10 ^ prec in a single 128 bit multiply, so the digits and the remainder used to
+ * round them come straight out without a big integer
+*/
+int _fixed_small_chars(char* data, uint64_t man, int k, int prec)
+{
+    uint64_t int_part = k < 64 ? man >> k : 0;
+    uint64_t frac = k < 64 ? man & ((1ull << k) - 1) : man;
+    unsigned __int128 prod = (unsigned __int128)frac * POW10[prec];
+    uint64_t q = (uint64_t)(prod >> k);
+    unsigned __int128 rem = prod - ((unsigned __int128)q << k);
+    unsigned __int128 half = (unsigned __int128)1 << (k - 1);
+    uint64_t last = prec > 0 ? q : int_part;
+    if(rem > half || (rem == half && (last & 1)))
+    {
+        q++;
+        if(q == POW10[prec])
+        {
+            q = 0;
+            int_part++;
+        }
+    }
+    // integer digits, decimal point and fraction digits
+    int int_length = _decimal_length(int_part);
+    _write_int_mag(int_part, data, int_length);
+    if(prec == 0)
+    {
+        return int_length;
+    }
+    data[int_length] = '.';
+    _write_int_mag(q, &(data[int_length + 1]), prec);
+    return int_length + 1 + prec;
+}
+#endif
+
+/*
+ * Internal function
+ * Prints val with exactly prec digits after the decimal point, padded to spec->width
+ * Returns the number of characters printed
+*/
+int _print_float_prec(printf_ctx* ctx, double val, int prec, const printf_spec* spec)
+{
+    int negative;
+    uint64_t man;
+    uint32_t bits_exp;
+    const char* special = _split_float(val, &negative, &man, &bits_exp);
+    if(special != NULL)
+    {
+        int n = _pad_start(ctx, spec, "-", negative, negative + 3, 0);
+        n += _print_buffer(ctx, special, 3);
+        return n + _pad_end(ctx, spec, negative + 3);
+    }
+    int exp;
+    _float_value(&man, bits_exp, &exp);
+#ifdef __SIZEOF_INT128__
+    if(exp < 0 && exp >= -64 && prec < 20)
+    {
+        char data[42];
+        data[0] = '-';
+        int len = negative + _fixed_small_chars(&(data[negative]), man, -exp, prec);
+        return _print_field(ctx, spec, data, len, negative, 1);
+    }
+#endif
+
+    // a value which rounds to 0 gets no digits at all, and otherwise digits past the one rounded on only matter
+    // as to whether they are 0
+    char digits[FLOAT_MAX_DIGITS];
+    int point = 0;
+    int len = man != 0 && !_rounds_to_zero(man, exp, prec) ? _exact_digits(man, exp, prec + 1, digits, &point) : 0;
+    // a carry out of the rounding or no integer digits gives a single leading digit
+    const char* lead = NULL;
+    if(_round_digits(digits, point + prec, len))
+    {
+        lead = "1";
+    }
+    else if(point == 0)
+    {
+        lead = "0";
+    }
+    int field_len = negative + (lead != NULL) + point + (prec > 0 ? 1 + prec : 0);
+    int n = _pad_start(ctx, spec, "-", negative, field_len, 1);
+    if(lead != NULL)
+    {
+        n += _print_buffer(ctx, lead, 1);
+    }
+    n += _print_buffer(ctx, digits, point);
+    if(prec > 0)
+    {
+        put_chars(ctx, ".", 1);
+        n++;
+        int frac_length = len - point < prec ? len - point : prec;
+        n += _print_buffer(ctx, &(digits[point]), frac_length);
+        put_fill(ctx, '0', prec - frac_length);
+        n += prec - frac_length;
+    }
+    return n + _pad_end(ctx, spec, field_len);
+}
+
+/*
+ * Internal function
+ * Prints val in scientific notation with exactly prec digits after the decimal point, padded to spec->width
+ * Returns the number of characters printed
+*/
+int _print_float_scientific_prec(printf_ctx* ctx, double val, int prec, const printf_spec* spec)
+{
+    int negative;
+    uint64_t man;
+    uint32_t bits_exp;
+    const char* special = _split_float(val, &negative, &man, &bits_exp);
+    if(special != NULL)
+    {
+        int n = _pad_start(ctx, spec, "-", negative, negative + 3, 0);
+        n += _print_buffer(ctx, special, 3);
+        return n + _pad_end(ctx, spec, negative + 3);
+    }
+    int exp;
+    _float_value(&man, bits_exp, &exp);
+
+    char digits[FLOAT_MAX_DIGITS];
+    int point = 0;
+    int len = 0;
+    int first = 0;
+    int exponent = 0;
+    if(man != 0)
+    {
+        len = _exact_digits(man, exp, _scientific_frac_digits(man, exp, prec), digits, &point);
+        while(digits[first] == '0')
+        {
+            first++;
+        }
+        exponent = point - first - 1;
+        if(_round_digits(&(digits[first]), prec + 1, len - first))
+        {
+            digits[first] = '1';
+            exponent++;
+        }
+    }
+    else
+    {
+        digits[0] = '0';
+        len = 1;
+    }
+
+    // e, exponent sign and up to 3 exponent digits
+    char data[5];
+    int pos = 0;
+    data[pos] = 'e';
+    pos++;
+    uint32_t exp_mag = exponent;
+    if(exponent < 0)
+    {
+        data[pos] = '-';
+        pos++;
+        exp_mag = -exponent;
+    }
+    int exp_length = _decimal_length(exp_mag);
+    _write_int_mag(exp_mag, &(data[pos]), exp_length);
+    pos += exp_length;
+
+    int field_len = negative + 1 + (prec > 0 ? 1 + prec : 0) + pos;
+    int n = _pad_start(ctx, spec, "-", negative, field_len, 1);
+    n += _print_buffer(ctx, &(digits[first]), 1);
+    if(prec > 0)
+    {
+        put_chars(ctx, ".", 1);
+        n++;
+        int frac_length = len - first - 1 < prec ? len - first - 1 : prec;
+        n += _print_buffer(ctx, &(digits[first + 1]), frac_length);
+        put_fill(ctx, '0', prec - frac_length);
+        n += prec - frac_length;
+    }
+    n += _print_buffer(ctx, data, pos);
+    return n + _pad_end(ctx, spec, field_len);
+}
+
+// spec with no padding, for printing a value on its own
+const printf_spec PLAIN_SPEC = {
+    .conv = 0,
+    .l = 0,
+    .prec = -1,
+    .flags = 0,
+    .width = 0
+};
+
+/*
+ * Prints a 64 bit floating point number in long format with exactly prec digits after the decimal point
+ * (as %.Nf does) and returns the number of characters printed
+ * The digits are correctly rounded from the exact value of the float, rounding half to even
+*/
+int print_float_prec(printf_ctx* ctx, double val, int prec)
+{
+    return _print_float_prec(ctx, val, prec, &PLAIN_SPEC);
+}
+
+/*
+ * Prints a 64 bit floating point number in scientific notation with exactly prec digits after the decimal
+ * point (as %.Ne does) and returns the number of characters printed
+ * The digits are correctly rounded from the exact value of the float, rounding half to even
+*/
+int print_float_scientific_prec(printf_ctx* ctx, double val, int prec)
+{
+    return _print_float_scientific_prec(ctx, val, prec, &PLAIN_SPEC);
+}
+
+/*
+ * Internal function
+ * Counts an invalid UTF-8 byte printed as '?' in the statistics of ctx
+*/
+void _count_invalid(printf_ctx* ctx)
+{
+    if(ctx->stats != NULL)
+    {
+        ctx->stats->invalid_utf8++;
+    }
+}
+
+/*
+ * Internal function
+ * Returns the number of bytes in the UTF-8 char starting with the bytes lead and next, or 0 if they can't start
+ * a valid one
+ * Only the shortest form of each code up to 0x10ffff is valid, so next has to be in a narrower range after some
+ * leads, which rules out overlong forms (c0 af), surrogates (ed a0 80) and codes past the end of Unicode
+ * (f4 90 80 80 or f7 bf bf bf)
+*/
+int _utf8_lead(uint8_t lead, uint8_t next)
+{
+    if(lead < 0xc2 || lead > 0xf4)
+    {
+        return 0;
+    }
+    uint8_t low = 0x80;
+    uint8_t high = 0xbf;
+    if(lead == 0xe0)
+    {
+        low = 0xa0;
+    }
+    else if(lead == 0xed)
+    {
+        high = 0x9f;
+    }
+    else if(lead == 0xf0)
+    {
+        low = 0x90;
+    }
+    else if(lead == 0xf4)
+    {
+        high = 0x8f;
+    }
+    if(next < low || next > high)
+    {
+        return 0;
+    }
+    return lead < 0xe0 ? 2 : lead < 0xf0 ? 3 : 4;
+}
+
+/*
+ * Decodes a UTF-8 char from str and returns the number of bytes it holds
+ * code is the Unicode character code of the UTF-8 bytes
+ * If the char is not in UTF-8 format (including overlong forms, surrogates and codes above 0x10ffff), returns 0
+ * and *code is 0
+*/
+int decode_char(const char* str, int* code)
+{
+    *code = 0;
+    int temp_code = 0; // used in process of building char
     // decode utf-8
     if((*str & 0x80) == 0)
     {
-        *code = *str;
-        return 1;
+        *code = *str;
+        return 1;
+    }
+    else if(_utf8_lead(str[0], str[1]) == 0)
+    {
+        return 0;
+    }
+    else if((*str & 0xe0) == 0xc0)
+    {
+        temp_code = (*str & 0x1f) << 6;
+        str++;
+        if((*str & 0xc0) == 0x80)
+        {
+            temp_code |= *str & 0x3f;
+            *code = temp_code;
+            return 2;
+        }
+    }
+    else if((*str & 0xf0) == 0xe0)
+    {
+        temp_code = (*str & 0xf) << 12;
+        str++;
+        if((*str & 0xc0) == 0x80)
+        {
+            temp_code |= (*str & 0x3f) << 6;
+            str++;
+            if((*str & 0xc0) == 0x80)
+            {
+                temp_code |= *str & 0x3f;
+                *code = temp_code;
+                return 3;
+            }
+        }
+    }
+    else if((*str & 0xf8) == 0xf0)
+    {
+        temp_code = (*str & 0x7) << 18;
+        str++;
+        if((*str & 0xc0) == 0x80)
+        {
+            temp_code |= (*str & 0x3f) << 12;
+            str++;
+            if((*str & 0xc0) == 0x80)
+            {
+                temp_code |= (*str & 0x3f) << 6;
+                str++;
+                if((*str & 0xc0) == 0x80)
+                {
+                    temp_code |= *str & 0x3f;
+                    *code = temp_code;
+                    return 4;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+#define SWAR_ONES 0x0101010101010101ull
+#define SWAR_HIGHS 0x8080808080808080ull
+
+/*
+ * Internal function
+ * Returns the number of plain ascii chars at the start of str before a NUL, the char stop or a non-ascii byte
+ * Once str is 8 byte aligned, 8 bytes are checked at a time
+ * Aligned loads never cross into the next page so reading past the NUL in the last word is safe
+*/
+int _ascii_run(const char* str, char stop)
+{
+    const char* start = str;
+    while(((uintptr_t)str & 7) != 0)
+    {
+        if(*str == 0 || *str == stop || (*str & 0x80) != 0)
+        {
+            return str - start;
+        }
+        str++;
+    }
+    const uint64_t stops = SWAR_ONES * (uint8_t)stop;
+    for(;;)
+    {
+        uint64_t word;
+        memcpy(&word, str, 8);
+        uint64_t is_stop = word ^ stops;
+        // high bit is set for bytes which are 0 or match stop (or are non-ascii which ends the run anyway)
+        uint64_t found = ((word - SWAR_ONES) & ~word) | ((is_stop - SWAR_ONES) & ~is_stop) | word;
+        if((found & SWAR_HIGHS) != 0)
+        {
+            break;
+        }
+        str += 8;
+    }
+    while(*str != 0 && *str != stop && (*str & 0x80) == 0)
+    {
+        str++;
+    }
+    return str - start;
+}
+
+/*
+ * Internal function
+ * Returns the number of bytes of valid UTF-8 at the start of str before a NUL, the char stop or an invalid byte
+ * chars is set to the number of unicode chars in them
+ * Valid means the same as for decode_char, but the chars are only checked, not decoded
+ * Callers take any leading ascii with _ascii_run first
+*/
+int _utf8_run(const char* str, char stop, int* chars)
+{
+    const char* start = str;
+    int n = 0;
+    for(;;)
+    {
+        uint8_t c = *str;
+        if(c < 0x80)
+        {
+            // ascii between non-ascii chars is usually short so it isn't worth _ascii_run
+            if(c == 0 || c == (uint8_t)stop)
+            {
+                break;
+            }
+            str++;
+            n++;
+            continue;
+        }
+        // the continuation bytes are checked in order so nothing past a NUL is read
+        int bytes = _utf8_lead(c, str[1]);
+        if(bytes == 0 || (bytes > 2 && (str[2] & 0xc0) != 0x80) || (bytes > 3 && (str[3] & 0xc0) != 0x80))
+        {
+            break;
+        }
+        str += bytes;
+        n++;
+    }
+    *chars = n;
+    return str - start;
+}
+
+/*
+ * Prints the string s, decoding any utf-8 chars in it
+ * For a context taking UTF-8 the valid runs are copied straight to the sink and only invalid bytes are replaced
+ * Returns the number of characters printed
+*/
+int print_string(printf_ctx* ctx, const char* s)
+{
+    int n = 0;
+    while(*s)
+    {
+        int run = _ascii_run(s, 0);
+        if(run > 0)
+        {
+            n += _print_ref(ctx, s, run);
+            s += run;
+            continue;
+        }
+        if(ctx->utf8)
+        {
+            int chars;
+            run = _utf8_run(s, 0, &chars);
+            if(run > 0)
+            {
+                put_ref(ctx, s, run);
+                n += chars;
+                s += run;
+                continue;
+            }
+        }
+        int code = 0;
+        int bytes = decode_char(s, &code);
+        if(bytes > 0)
+        {
+            put_char(ctx, code);
+            s += bytes;
+        }
+        else
+        {
+            _count_invalid(ctx);
+            put_char(ctx, '?');
+            s++;
+        }
+        n++;
+    }
+    return n;
+}
+
+/*
+ * Internal function
+ * Returns the number of characters print_string prints for s, without printing them
+*/
+int _string_length(const char* s)
+{
+    int n = 0;
+    while(*s)
+    {
+        int run = _ascii_run(s, 0);
+        if(run > 0)
+        {
+            n += run;
+            s += run;
+            continue;
+        }
+        int code = 0;
+        int bytes = decode_char(s, &code);
+        s += bytes > 0 ? bytes : 1;
+        n++;
+    }
+    return n;
+}
+
+/*
+ * Internal function
+ * Returns the number of plain ascii bytes at the start of the len bytes of str
+ * The length is known so 8 bytes are checked at a time from the start, with no need to align or look for a NUL
+*/
+int _ascii_span(const char* str, int len)
+{
+    int n = 0;
+    for(; n + 8 <= len; n += 8)
+    {
+        uint64_t word;
+        memcpy(&word, &(str[n]), 8);
+        if((word & SWAR_HIGHS) != 0)
+        {
+            break;
+        }
+    }
+    while(n < len && (str[n] & 0x80) == 0)
+    {
+        n++;
+    }
+    return n;
+}
+
+/*
+ * Internal function
+ * Returns the number of bytes in the valid UTF-8 char at the start of the len bytes of str, or 0 if it isn't
+ * valid or is cut off by the end of str
+ * Valid means the same as for decode_char, so once this passes decode_char reads no further than the char
+*/
+int _utf8_char_length(const char* str, int len)
+{
+    uint8_t c = *str;
+    if(c < 0x80)
+    {
+        return 1;
+    }
+    if(len < 2)
+    {
+        return 0;
+    }
+    int bytes = _utf8_lead(c, str[1]);
+    if(bytes > len || (bytes > 2 && (str[2] & 0xc0) != 0x80) || (bytes > 3 && (str[3] & 0xc0) != 0x80))
+    {
+        return 0;
+    }
+    return bytes;
+}
+
+/*
+ * Internal function
+ * Returns the number of bytes of valid UTF-8 at the start of the len bytes of str before an invalid byte
+ * chars is set to the number of unicode chars in them
+ * Works the same as _utf8_run, but stops at the end of str rather than at a NUL
+*/
+int _utf8_span(const char* str, int len, int* chars)
+{
+    int pos = 0;
+    int n = 0;
+    while(pos < len)
+    {
+        int bytes = _utf8_char_length(&(str[pos]), len - pos);
+        if(bytes == 0)
+        {
+            break;
+        }
+        pos += bytes;
+        n++;
+    }
+    *chars = n;
+    return pos;
+}
+
+/*
+ * Returns the number of bytes of valid UTF-8 at the start of the len bytes of str, stopping at the first
+ * invalid byte or char cut off by the end of str
+ * chars is set to the number of unicode chars in them
+*/
+int valid_utf8_length(const char* str, int len, int* chars)
+{
+    int ascii = _ascii_span(str, len);
+    int run = _utf8_span(&(str[ascii]), len - ascii, chars);
+    *chars += ascii;
+    return ascii + run;
+}
+
+/*
+ * Prints exactly len bytes of s, decoding any utf-8 chars in them
+ * Unlike print_string, s doesn't need a NUL at the end and a NUL within it is printed like any other char, so
+ * this suits slices of a larger string and strings stored with their length
+ * The ascii spans (and for a context taking UTF-8, the valid runs) are copied to the sink in blocks, and a
+ * UTF-8 char cut off by the end of s is invalid
+ * Returns the number of characters printed
+*/
+int print_string_n(printf_ctx* ctx, const char* s, int len)
+{
+    int n = 0;
+    const char* end = s + len;
+    while(s < end)
+    {
+        int run = _ascii_span(s, end - s);
+        if(run > 0)
+        {
+            n += _print_ref(ctx, s, run);
+            s += run;
+            continue;
+        }
+        if(ctx->utf8)
+        {
+            int chars;
+            run = _utf8_span(s, end - s, &chars);
+            if(run > 0)
+            {
+                put_ref(ctx, s, run);
+                n += chars;
+                s += run;
+                continue;
+            }
+        }
+        int bytes = _utf8_char_length(s, end - s);
+        if(bytes > 0)
+        {
+            int code = 0;
+            decode_char(s, &code);
+            put_char(ctx, code);
+            s += bytes;
+        }
+        else
+        {
+            _count_invalid(ctx);
+            put_char(ctx, '?');
+            s++;
+        }
+        n++;
+    }
+    return n;
+}
+
+/*
+ * Internal function
+ * Returns the number of characters print_string_n prints for the len bytes of s, without printing them
+*/
+int _string_length_n(const char* s, int len)
+{
+    int n = 0;
+    int pos = 0;
+    while(pos < len)
+    {
+        int run = _ascii_span(&(s[pos]), len - pos);
+        if(run > 0)
+        {
+            n += run;
+            pos += run;
+            continue;
+        }
+        int bytes = _utf8_char_length(&(s[pos]), len - pos);
+        pos += bytes > 0 ? bytes : 1;
+        n++;
+    }
+    return n;
+}
+
+/*
+ * Internal function
+ * Returns the number of bytes of s printed by %.Ns with a precision of prec, which is prec or up to the NUL
+ * if that comes first
+ * s is only read up to the NUL or prec bytes, so it doesn't need a NUL at the end if it is at least prec bytes
+*/
+int _string_prec_length(const char* s, int prec)
+{
+    const char* nul = memchr(s, 0, prec);
+    return nul != NULL ? nul - s : prec;
+}
+
+/*
+ * Prints the char byte c
+ * Returns the number of characters printed
+*/
+int print_char(printf_ctx* ctx, char c)
+{
+    put_char(ctx, c);
+    return 1;
+}
+
+/*
+ * Internal function
+ * Parses the format specifier starting at the '%' str points to into spec
+ * Returns the number of chars of str used by the specifier
+ * If the specifier is invalid, spec->conv is 0 and only the '%' and any flags, width, precision and length
+ * specifier are used so the chars following are printed as normal text
+*/
+int _parse_spec(const char* str, printf_spec* spec)
+{
+    int len = 1;
+    spec->l = 0;
+    spec->prec = -1;
+    spec->flags = 0;
+    spec->width = 0;
+    for(;; len++)
+    {
+        if(str[len] == '-')
+        {
+            spec->flags |= PRINTF_FLAG_LEFT;
+        }
+        else if(str[len] == '0')
+        {
+            spec->flags |= PRINTF_FLAG_ZERO;
+        }
+        else
+        {
+            break;
+        }
     }
-    else if((*str & 0xe0) == 0xc0)
+    if(str[len] == '*')
     {
-        temp_code = (*str & 0x1f) << 6;
-        str++;
-        if((*str & 0xc0) == 0x80)
+        spec->width = PRINTF_WIDTH_ARG;
+        len++;
+    }
+    else
+    {
+        int width = 0;
+        while(str[len] >= '0' && str[len] <= '9')
+        {
+            width = width * 10 + str[len] - '0';
+            if(width > PRINTF_MAX_WIDTH)
+            {
+                width = PRINTF_MAX_WIDTH;
+            }
+            len++;
+        }
+        spec->width = width;
+    }
+    if(str[len] == '.' && str[len + 1] == '*')
+    {
+        spec->prec = PRINTF_PREC_ARG;
+        len += 2;
+    }
+    else if(str[len] == '.')
+    {
+        // a '.' with no digits is a precision of 0
+        len++;
+        int prec = 0;
+        while(str[len] >= '0' && str[len] <= '9')
+        {
+            prec = prec * 10 + str[len] - '0';
+            if(prec > PRINTF_MAX_PRECISION)
+            {
+                prec = PRINTF_MAX_PRECISION;
+            }
+            len++;
+        }
+        spec->prec = prec;
+    }
+    if(str[len] == 'l')
+    {
+        spec->l = 1;
+        len++;
+    }
+    spec->conv = str[len];
+    switch(spec->conv)
+    {
+        case 'd':
+        case 'u':
+        case 'b':
+        case 'o':
+        case 'h':
+        {
+            if(spec->prec != -1)
+            {
+                spec->conv = 0;
+            }
+            else
+            {
+                len++;
+            }
+            break;
+        }
+        case 'f':
+        case 'e':
+        {
+            if(spec->l)
+            {
+                spec->conv = 0;
+            }
+            else
+            {
+                len++;
+            }
+            break;
+        }
+        case 's':
+        {
+            if(spec->l)
+            {
+                spec->conv = 0;
+            }
+            else
+            {
+                len++;
+            }
+            break;
+        }
+        case 'c':
+        {
+            if(spec->l || spec->prec != -1)
+            {
+                spec->conv = 0;
+            }
+            else
+            {
+                len++;
+            }
+            break;
+        }
+        case '%':
+        {
+            if(spec->l || spec->prec != -1 || spec->flags != 0 || spec->width != 0)
+            {
+                spec->conv = 0;
+            }
+            else
+            {
+                len++;
+            }
+            break;
+        }
+        default:
+        {
+            spec->conv = 0;
+        }
+    }
+    return len;
+}
+
+/*
+ * Internal function
+ * Returns the text printed for the invalid specifier spec, "?" if it has any flags, width, precision or length
+ * specifier and "%" if not
+*/
+const char* _invalid_text(const printf_spec* spec)
+{
+    return spec->l || spec->prec != -1 || spec->flags != 0 || spec->width != 0 ? "?" : "%";
+}
+
+/*
+ * Internal function
+ * Returns whether c is a decimal digit (so a float's text isn't NaN or INF, which are padded with spaces even
+ * with the '0' flag)
+*/
+int _is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/*
+ * Internal function
+ * yaos_format_string without counting the conversion in the statistics of ctx, for callers which count it
+ * themselves
+*/
+int _format_string(printf_ctx* ctx, const printf_spec* spec, const char* s, int len)
+{
+    int n = 0;
+    if(spec->width > 0 && (spec->flags & PRINTF_FLAG_LEFT) == 0)
+    {
+        n = _pad_start(ctx, spec, NULL, 0, _string_length_n(s, len), 0);
+    }
+    int str_len = print_string_n(ctx, s, len);
+    return n + str_len + _pad_end(ctx, spec, str_len);
+}
+
+/*
+ * Internal function
+ * Prints value using the format specifier spec, padded to spec->width
+ * Integers and floats with no precision are written to a buffer whose length gives the padding, floats with a
+ * precision work out their length from the rounded digits and strings count their chars first
+ * Returns the number of characters printed
+*/
+int _format_field(printf_ctx* ctx, const printf_spec* spec, printf_value value)
+{
+    char data[PRINTF_FLOAT_CHARS];
+    int len;
+    int prefix_len = 0;
+    int zero = 1;
+    switch(spec->conv)
+    {
+        case 's':
+        {
+            if(spec->prec >= 0)
+            {
+                return _format_string(ctx, spec, value.s, _string_prec_length(value.s, spec->prec));
+            }
+            int n = 0;
+            if((spec->flags & PRINTF_FLAG_LEFT) == 0)
+            {
+                n = _pad_start(ctx, spec, NULL, 0, _string_length(value.s), 0);
+            }
+            int str_len = print_string(ctx, value.s);
+            return n + str_len + _pad_end(ctx, spec, str_len);
+        }
+        case 'c':
+        {
+            int n = _pad_start(ctx, spec, NULL, 0, 1, 0);
+            n += print_char(ctx, (char)value.i);
+            return n + _pad_end(ctx, spec, 1);
+        }
+        case 'd':
+        {
+            len = int_to_chars(data, PRINTF_INT_CHARS, value.i);
+            prefix_len = value.i < 0;
+            break;
+        }
+        case 'u':
+        {
+            len = unsigned_to_chars(data, PRINTF_INT_CHARS, value.u);
+            break;
+        }
+        case 'b':
+        {
+            len = bin_to_chars(data, PRINTF_BIN_CHARS, value.u);
+            prefix_len = 2;
+            break;
+        }
+        case 'o':
+        {
+            len = oct_to_chars(data, PRINTF_OCT_CHARS, value.u);
+            prefix_len = 2;
+            break;
+        }
+        case 'h':
+        {
+            len = hex_to_chars(data, PRINTF_HEX_CHARS, value.u);
+            prefix_len = 2;
+            break;
+        }
+        case 'f':
+        {
+            if(spec->prec >= 0)
+            {
+                return _print_float_prec(ctx, value.d, spec->prec, spec);
+            }
+            len = float_to_chars(data, PRINTF_FLOAT_CHARS, value.d, ctx->sig_figs);
+            prefix_len = data[0] == '-';
+            zero = _is_digit(data[prefix_len]);
+            break;
+        }
+        case 'e':
+        {
+            if(spec->prec >= 0)
+            {
+                return _print_float_scientific_prec(ctx, value.d, spec->prec, spec);
+            }
+            len = float_scientific_to_chars(data, PRINTF_FLOAT_SCIENTIFIC_CHARS, value.d, ctx->sig_figs);
+            prefix_len = data[0] == '-';
+            zero = _is_digit(data[prefix_len]);
+            break;
+        }
+        default:
+        {
+            put_chars(ctx, _invalid_text(spec), 1);
+            return 1;
+        }
+    }
+    return _print_field(ctx, spec, data, len, prefix_len, zero);
+}
+
+/*
+ * Internal function
+ * Prints value using the format specifier spec, see yaos_format_value
+*/
+int _format_value(printf_ctx* ctx, const printf_spec* spec, printf_value value)
+{
+    if(spec->width > 0)
+    {
+        return _format_field(ctx, spec, value);
+    }
+    switch(spec->conv)
+    {
+        case 's':
+        {
+            if(spec->prec >= 0)
+            {
+                return print_string_n(ctx, value.s, _string_prec_length(value.s, spec->prec));
+            }
+            return print_string(ctx, value.s);
+        }
+        case 'c':
+        {
+            return print_char(ctx, (char)value.i);
+        }
+        case 'd':
+        {
+            return print_int(ctx, value.i);
+        }
+        case 'u':
+        {
+            return print_unsigned_int(ctx, value.u);
+        }
+        case 'b':
+        {
+            return print_bin(ctx, value.u);
+        }
+        case 'o':
+        {
+            return print_oct(ctx, value.u);
+        }
+        case 'h':
+        {
+            return print_hex(ctx, value.u);
+        }
+        case 'f':
+        {
+            if(spec->prec >= 0)
+            {
+                return print_float_prec(ctx, value.d, spec->prec);
+            }
+            return print_float(ctx, value.d);
+        }
+        case 'e':
+        {
+            if(spec->prec >= 0)
+            {
+                return print_float_scientific_prec(ctx, value.d, spec->prec);
+            }
+            return print_float_scientific(ctx, value.d);
+        }
+        case '%':
+        {
+            put_chars(ctx, "%", 1);
+            return 1;
+        }
+        default:
+        {
+            put_chars(ctx, _invalid_text(spec), 1);
+            return 1;
+        }
+    }
+}
+
+/*
+ * Prints value using the format specifier spec
+ * Returns the number of characters printed
+ *
+ * When you have an invalid length specifier or precision for a certain format or you have the length
+ * specifier or precision and no known format (or no format at all), the character '?' is outputted
+ * When you have no known format and no flags, width, length specifier or precision, the character '%' is
+ * outputted
+*/
+int yaos_format_value(printf_ctx* ctx, const printf_spec* spec, printf_value value)
+{
+    int num = _format_value(ctx, spec, value);
+    if(ctx->stats != NULL)
+    {
+        _count_conv(ctx->stats, spec->conv, num);
+    }
+    return num;
+}
+
+/*
+ * Prints the float val using the %f or %e format specifier spec
+ * Works the same as yaos_format_value, but with no precision the shortest digits are those of the float
+ * rather than of it widened to a double (see print_float32)
+ * Returns the number of characters printed
+*/
+int yaos_format_float32(printf_ctx* ctx, const printf_spec* spec, float val)
+{
+    if(spec->prec >= 0 || (spec->conv != 'f' && spec->conv != 'e'))
+    {
+        printf_value value;
+        value.d = val;
+        return yaos_format_value(ctx, spec, value);
+    }
+    int scientific = spec->conv == 'e';
+    char data[PRINTF_FLOAT_CHARS];
+    int negative;
+    floating_decimal_64 dec;
+    const char* special = _decode_float32_sig_figs(val, scientific, ctx->sig_figs, &negative, &dec);
+    int len = _float_chars(data, PRINTF_FLOAT_CHARS, negative, special, dec, ctx->sig_figs, scientific);
+    int num = _print_field(ctx, spec, data, len, negative, _is_digit(data[negative]));
+    if(ctx->stats != NULL)
+    {
+        _count_conv(ctx->stats, spec->conv, num);
+    }
+    return num;
+}
+
+/*
+ * Prints the len bytes of the string s using the %s format specifier spec, padded to spec->width
+ * The precision of spec isn't used, len is the number of bytes printed (see print_string_n)
+ * Returns the number of characters printed
+*/
+int yaos_format_string(printf_ctx* ctx, const printf_spec* spec, const char* s, int len)
+{
+    int n = _format_string(ctx, spec, s, len);
+    if(ctx->stats != NULL)
+    {
+        _count_conv(ctx->stats, 's', n);
+    }
+    return n;
+}
+
+/*
+ * Takes the argument for the format specifier spec from args
+ * 32 bit integers are widened to 64 bits and chars are held in value.i
+ * Specifiers with no argument return 0
+*/
+printf_value yaos_read_arg(const printf_spec* spec, va_list* args)
+{
+    printf_value value;
+    value.u = 0;
+    switch(spec->conv)
+    {
+        case 's':
+        {
+            value.s = va_arg(*args, const char*);
+            break;
+        }
+        case 'c':
+        {
+            value.i = (char)va_arg(*args, int); // char byte promoted to int
+            break;
+        }
+        case 'd':
+        {
+            value.i = spec->l ? va_arg(*args, int64_t) : (int64_t)va_arg(*args, int32_t);
+            break;
+        }
+        case 'u':
+        case 'b':
+        case 'o':
+        case 'h':
+        {
+            value.u = spec->l ? va_arg(*args, uint64_t) : (uint64_t)va_arg(*args, uint32_t);
+            break;
+        }
+        case 'f':
+        case 'e':
+        {
+            value.d = va_arg(*args, double);
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+    return value;
+}
+
+/*
+ * Sets the width of spec to the value of a * argument
+ * A negative width is left aligned, as if the '-' flag was given
+*/
+void yaos_set_width(printf_spec* spec, int width)
+{
+    if(width < 0)
+    {
+        spec->flags |= PRINTF_FLAG_LEFT;
+        width = width < -PRINTF_MAX_WIDTH ? -PRINTF_MAX_WIDTH : width;
+        width = -width;
+    }
+    spec->width = width > PRINTF_MAX_WIDTH ? PRINTF_MAX_WIDTH : width;
+}
+
+/*
+ * Sets the precision of spec to the value of a .* argument
+ * A negative precision is taken as if no precision was given, as in C
+*/
+void yaos_set_prec(printf_spec* spec, int prec)
+{
+    if(prec < 0)
+    {
+        spec->prec = -1;
+        return;
+    }
+    spec->prec = prec > PRINTF_MAX_PRECISION ? PRINTF_MAX_PRECISION : prec;
+}
+
+/*
+ * Internal function
+ * Prints the argument for the format specifier spec, taking it (and a * width and .* precision before it, in
+ * that order) from args
+ * Invalid specifiers take no arguments, even with a * width or .* precision
+ * Returns the number of characters printed
+*/
+int _format_spec(printf_ctx* ctx, const printf_spec* spec, va_list* args)
+{
+    if((spec->width == PRINTF_WIDTH_ARG || spec->prec == PRINTF_PREC_ARG) && spec->conv != 0)
+    {
+        printf_spec resolved = *spec;
+        if(spec->width == PRINTF_WIDTH_ARG)
+        {
+            yaos_set_width(&resolved, va_arg(*args, int));
+        }
+        if(spec->prec == PRINTF_PREC_ARG)
         {
-            temp_code |= *str & 0x3f;
-            *code = temp_code;
-            return 2;
+            yaos_set_prec(&resolved, va_arg(*args, int));
         }
+        return yaos_format_value(ctx, &resolved, yaos_read_arg(&resolved, args));
     }
-    else if((*str & 0xf0) == 0xe0)
+    return yaos_format_value(ctx, spec, yaos_read_arg(spec, args));
+}
+
+/*
+ * Parses the next piece of the format string str into op
+ * This is either a run of ascii text, a single unicode char or a format specifier
+ * Returns the number of chars of str used
+*/
+int yaos_parse_op(const char* str, printf_op* op)
+{
+    if(*str == '%')
     {
-        temp_code = (*str & 0xf) << 12;
-        str++;
-        if((*str & 0xc0) == 0x80)
+        int len = _parse_spec(str, &(op->spec));
+        op->type = PRINTF_OP_CONV;
+        if(op->spec.conv == '%')
         {
-            temp_code |= (*str & 0x3f) << 6;
-            str++;
-            if((*str & 0xc0) == 0x80)
-            {
-                temp_code |= *str & 0x3f;
-                *code = temp_code;
-                return 3;
-            }
+            // %% is just the text "%"
+            op->type = PRINTF_OP_TEXT;
+            op->str = &(str[1]);
+            op->len = 1;
+        }
+        else if(op->spec.conv == 0)
+        {
+            op->type = PRINTF_OP_TEXT;
+            op->str = _invalid_text(&(op->spec));
+            op->len = 1;
         }
+        return len;
     }
-    else if((*str & 0xf8) == 0xf0)
+    int run = _ascii_run(str, '%');
+    if(run > 0)
     {
-        temp_code = (*str & 0x7) << 18;
-        str++;
-        if((*str & 0xc0) == 0x80)
+        op->type = PRINTF_OP_TEXT;
+        op->str = str;
+        op->len = run;
+        return run;
+    }
+    op->type = PRINTF_OP_CODE;
+    int bytes = decode_char(str, &(op->len));
+    if(bytes == 0)
+    {
+        op->len = '?'; // no idea what char encoded
+        bytes = 1;
+    }
+    return bytes;
+}
+
+/*
+ * Internal function
+ * Prints the pieces of a format string in ops, taking arguments from args
+ * Returns the number of chars printed
+*/
+int _format_ops(printf_ctx* ctx, const printf_op* ops, int num_ops, va_list* args)
+{
+    int num = 0;
+    for(int i = 0; i < num_ops; i++)
+    {
+        const printf_op* op = &(ops[i]);
+        switch(op->type)
         {
-            temp_code |= (*str & 0x3f) << 12;
-            str++;
-            if((*str & 0xc0) == 0x80)
+            case PRINTF_OP_TEXT:
             {
-                temp_code |= (*str & 0x3f) << 6;
-                str++;
-                if((*str & 0xc0) == 0x80)
+                num += _print_ref(ctx, op->str, op->len);
+                break;
+            }
+            case PRINTF_OP_CODE:
+            {
+                // ascii '?' is always in a text op so a '?' code is an invalid byte
+                if(op->len == '?')
                 {
-                    temp_code |= *str & 0x3f;
-                    *code = temp_code;
-                    return 4;
+                    _count_invalid(ctx);
                 }
+                put_char(ctx, op->len);
+                num++;
+                break;
+            }
+            default:
+            {
+                num += _format_spec(ctx, &(op->spec), args);
             }
         }
     }
-    return 0;
+    return num;
+}
+
+/*
+ * Compiles the format string str into a list of pieces which can be printed by yaos_vformat_compiled
+ * without parsing str again
+ * At most max_ops pieces are written to ops
+ * Returns the number of pieces str needs, which if greater than max_ops means ops is incomplete
+ * The pieces point into str for their text so str must stay valid while they are used
+*/
+int yaos_compile(const char* str, printf_op* ops, int max_ops)
+{
+    int num_ops = 0;
+    while(*str != 0)
+    {
+        printf_op op;
+        str += yaos_parse_op(str, &op);
+        if(num_ops < max_ops)
+        {
+            ops[num_ops] = op;
+        }
+        num_ops++;
+    }
+    return num_ops;
+}
+
+/*
+ * Prints a format string compiled by yaos_compile to ctx
+ * Returns number of characters outputted
+*/
+int yaos_vformat_compiled(printf_ctx* ctx, const printf_op* ops, int num_ops, va_list arg_list)
+{
+    uint64_t start = ctx->stats != NULL ? _stats_ticks() : 0;
+    va_list args;
+    va_copy(args, arg_list);
+    int num = _format_ops(ctx, ops, num_ops, &args);
+    va_end(args);
+    if(ctx->stats != NULL)
+    {
+        _count_call(ctx->stats, num, start);
+    }
+    return num;
+}
+
+int yaos_format_compiled(printf_ctx* ctx, const printf_op* ops, int num_ops, ...)
+{
+    va_list arg_list;
+    va_start(arg_list, num_ops);
+    int num = yaos_vformat_compiled(ctx, ops, num_ops, arg_list);
+    va_end(arg_list);
+    return num;
+}
+
+/*
+ * Sets up an empty format cache
+*/
+void printf_cache_init(printf_cache* cache)
+{
+    for(int i = 0; i < PRINTF_CACHE_SLOTS; i++)
+    {
+        cache->entries[i].format = NULL;
+        cache->entries[i].num_ops = 0;
+    }
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->uncached = 0;
+}
+
+/*
+ * Returns the cache entry holding the compiled version of str, compiling it into its slot if needed
+ * Returns NULL if str has more than PRINTF_CACHE_OPS pieces and can't be cached
+ * These are remembered in the slot so they aren't compiled again each call
+*/
+const printf_cache_entry* printf_cache_lookup(printf_cache* cache, const char* str)
+{
+    // fibonacci hash of the pointer, dropping the low bits which are mostly the same
+    uint32_t slot = (uint32_t)((((uintptr_t)str >> 2) * 0x9e3779b97f4a7c15ull) >> 32) % PRINTF_CACHE_SLOTS;
+    printf_cache_entry* entry = &(cache->entries[slot]);
+    if(entry->format != str)
+    {
+        cache->misses++;
+        entry->format = str;
+        entry->num_ops = yaos_compile(str, entry->ops, PRINTF_CACHE_OPS);
+    }
+    else if(entry->num_ops <= PRINTF_CACHE_OPS)
+    {
+        cache->hits++;
+    }
+    if(entry->num_ops > PRINTF_CACHE_OPS)
+    {
+        cache->uncached++;
+        return NULL;
+    }
+    return entry;
 }
 
 /*
- * Prints the string given to it
- * Also formats the string based on the arguments given
+ * Prints the string given to it to the sink held in ctx
+ * Also formats the string based on the arguments given in args
  * Returns number of characters outputted
+ * All output state is held in ctx so different contexts can be formatted to in parallel
  *
  * This is a cut down version of the actual printf function designed to print out values stored
  * but not to have all the features provided by the stdlib printf
@@ -576,227 +3012,323 @@ int decode_char(const char* str, int* code)
  * l -> int    means int type is 64 bit wide
  * floats are automatically promoted to doubles when provided as an argument
  *
+ * flags and width (%[flags][width][.prec][l]conv)
+ * - -> left align the field, padding it with spaces on the right
+ * 0 -> pad numbers with zeros after the sign or 0x / 0b / 0o prefix (%08h of 0xbe is 0x0000be)
+ * N -> print at least N chars, padding with spaces on the left unless another flag is given
+ * * -> take the width from an int argument before the value (a negative width is left aligned)
+ *
+ * precision (%.Nf %.Ne %.Ns)
+ * .N -> digits after the decimal point for %f and %e, at most N bytes of the string for %s (stopping at a NUL
+ *       before them, so the string needn't have a NUL if it is at least N bytes)
+ * .* -> take the precision from an int argument after any * width, before the value (a negative precision is
+ *       ignored), capped at PRINTF_MAX_PRECISION so use print_string_n for longer slices
+ *
  * When you have an invalid length specifier for a certain format or you have the length specifier and no
  * known format (or no format at all), the character '?' is outputted
 */
-#ifdef TEST
-int my_printf(const char* str, ...)
-#else
-int printf(const char* str, ...)
-#endif
+int yaos_vformat(printf_ctx* ctx, const char* str, va_list arg_list)
 {
     int num = 0; // number of chars printed
-    va_list arg_list;
-    va_start(arg_list, str);
+    uint64_t start = ctx->stats != NULL ? _stats_ticks() : 0;
+    va_list args;
+    va_copy(args, arg_list);
+    if(ctx->cache != NULL)
+    {
+        const printf_cache_entry* entry = printf_cache_lookup(ctx->cache, str);
+        if(entry != NULL)
+        {
+            num = _format_ops(ctx, entry->ops, entry->num_ops, &args);
+            va_end(args);
+            if(ctx->stats != NULL)
+            {
+                _count_call(ctx->stats, num, start);
+            }
+            return num;
+        }
+    }
     while(*str != 0)
     {
         if(*str == '%')
         {
-            char l = 0; // have l flag (0 or 1)
-            str++;
-            if(*str == 'l')
+            printf_spec spec;
+            str += _parse_spec(str, &spec);
+            num += _format_spec(ctx, &spec, &args);
+            continue;
+        }
+        // print out run of plain ascii chars up to the next format specifier in one go
+        int run = _ascii_run(str, '%');
+        if(run > 0)
+        {
+            num += _print_ref(ctx, str, run);
+            str += run;
+            continue;
+        }
+        // a sink taking UTF-8 gets valid non-ascii text as it is
+        if(ctx->utf8)
+        {
+            int chars;
+            run = _utf8_run(str, '%', &chars);
+            if(run > 0)
             {
-                l = 1;
-                str++;
+                put_ref(ctx, str, run);
+                num += chars;
+                str += run;
+                continue;
             }
-            switch(*str)
+        }
+        int code = 0;
+        int bytes = decode_char(str, &code);
+        if(bytes > 0)
+        {
+            put_char(ctx, code);
+            str += bytes;
+        }
+        else
+        {
+            _count_invalid(ctx);
+            put_char(ctx, '?'); // no idea what char encoded
+            str++;
+        }
+        num++;
+    }
+    va_end(args);
+    if(ctx->stats != NULL)
+    {
+        _count_call(ctx->stats, num, start);
+    }
+    return num;
+}
+
+/*
+ * Like yaos_vformat but takes the arguments directly
+*/
+int yaos_format(printf_ctx* ctx, const char* str, ...)
+{
+    va_list arg_list;
+    va_start(arg_list, str);
+    int num = yaos_vformat(ctx, str, arg_list);
+    va_end(arg_list);
+    return num;
+}
+
+/*
+ * Formats str into buffer, which can hold size unicode chars
+ * At most size - 1 chars are written followed by a 0 terminator
+ * Returns the number of chars the full output would have taken (not including the terminator)
+*/
+int yaos_vsnprintf(int* buffer, int size, const char* str, va_list arg_list)
+{
+    printf_ctx ctx;
+    if(buffer == NULL || size <= 0)
+    {
+        // nothing can be written so only count the output
+        printf_ctx_init_buffer(&ctx, NULL, 0);
+        return yaos_vformat(&ctx, str, arg_list);
+    }
+    printf_ctx_init_buffer(&ctx, buffer, size - 1);
+    int num = yaos_vformat(&ctx, str, arg_list);
+    buffer[ctx.buffer_index] = 0;
+    return num;
+}
+
+int yaos_snprintf(int* buffer, int size, const char* str, ...)
+{
+    va_list arg_list;
+    va_start(arg_list, str);
+    int num = yaos_vsnprintf(buffer, size, str, arg_list);
+    va_end(arg_list);
+    return num;
+}
+
+/*
+ * Formats str into buffer as UTF-8, which can hold size bytes
+ * At most size - 1 bytes are written followed by a 0 terminator, cut at the end of a whole char
+ * Returns the number of bytes the full output would have taken (not including the terminator)
+*/
+int yaos_vsnprintf_utf8(char* buffer, int size, const char* str, va_list arg_list)
+{
+    printf_ctx ctx;
+    if(buffer == NULL || size <= 0)
+    {
+        printf_ctx_init_utf8_buffer(&ctx, NULL, 0);
+        yaos_vformat(&ctx, str, arg_list);
+        return ctx.utf8_length;
+    }
+    printf_ctx_init_utf8_buffer(&ctx, buffer, size - 1);
+    yaos_vformat(&ctx, str, arg_list);
+    buffer[ctx.buffer_index] = 0;
+    return ctx.utf8_length;
+}
+
+int yaos_snprintf_utf8(char* buffer, int size, const char* str, ...)
+{
+    va_list arg_list;
+    va_start(arg_list, str);
+    int num = yaos_vsnprintf_utf8(buffer, size, str, arg_list);
+    va_end(arg_list);
+    return num;
+}
+
+/*
+ * Internal function
+ * Returns the number of UTF-8 bytes yaos_format_value prints for value with spec, working out the length of
+ * integers, floats with no precision and valid UTF-8 strings from their digit and char counts without writing them
+ * Anything else (floats with a precision, whose rounding can carry into another digit, and strings with invalid
+ * bytes) is printed to counter, a context which only counts bytes
+*/
+int _measure_value(printf_ctx* counter, const printf_spec* spec, printf_value value)
+{
+    int len;
+    switch(spec->conv)
+    {
+        case 's':
+        {
+            int bytes = spec->prec >= 0 ? _string_prec_length(value.s, spec->prec) : (int)strlen(value.s);
+            int chars;
+            if(valid_utf8_length(value.s, bytes, &chars) != bytes)
             {
-                case 's':
-                {
-                    if(l)
-                    {
-                        put_char('?');
-                        num++;
-                    }
-                    else
-                    {
-                        const char* s = va_arg(arg_list, const char*);
-                        while(*s)
-                        {
-                            int code = 0;
-                            int bytes = decode_char(s, &code);
-                            if(bytes > 0)
-                            {
-                                put_char(code);
-                                s += bytes;
-                            }
-                            else
-                            {
-                                put_char('?');
-                                s++;
-                            }
-                            num++;
-                        }
-                        str++;
-                    }
-                    break;
-                }
-                case 'c':
-                {
-                    if(l)
-                    {
-                        put_char('?');
-                        num++;
-                    }
-                    else
-                    {
-                        char c = (char)va_arg(arg_list, int); // char byte promoted to int
-                        put_char(c);
-                        num++;
-                        str++;
-                    }
-                    break;
-                }
-                case 'd':
-                {
-                    if(l)
-                    {
-                        int64_t d = va_arg(arg_list, int64_t);
-                        num += print_int(d);
-                    }
-                    else
-                    {
-                        int32_t d = va_arg(arg_list, int32_t);
-                        num += print_int((int64_t)d);
-                    }
-                    str++;
-                    break;
-                }
-                case 'u':
-                {
-                    if(l)
-                    {
-                        uint64_t u = va_arg(arg_list, uint64_t);
-                        num += print_unsigned_int(u);
-                    }
-                    else
-                    {
-                        uint32_t u = va_arg(arg_list, uint32_t);
-                        num += print_unsigned_int((uint64_t)u);
-                    }
-                    str++;
-                    break;
-                }
-                case 'b':
-                {
-                    if(l)
-                    {
-                        uint64_t b = va_arg(arg_list, uint64_t);
-                        num += print_bin(b);
-                    }
-                    else
-                    {
-                        uint32_t b = va_arg(arg_list, uint32_t);
-                        num += print_bin((uint64_t)b);
-                    }
-                    str++;
-                    break;
-                }
-                case 'o':
-                {
-                    if(l)
-                    {
-                        uint64_t o = va_arg(arg_list, uint64_t);
-                        num += print_oct(o);
-                    }
-                    else
-                    {
-                        uint32_t o = va_arg(arg_list, uint32_t);
-                        num += print_oct((uint64_t)o);
-                    }
-                    str++;
-                    break;
-                }
-                case 'h':
-                {
-                    if(l)
-                    {
-                        uint64_t h = va_arg(arg_list, uint64_t);
-                        num += print_hex(h);
-                    }
-                    else
-                    {
-                        uint32_t h = va_arg(arg_list, uint32_t);
-                        num += print_hex((uint64_t)h);
-                    }
-                    str++;
-                    break;
-                }
-                case 'f':
-                {
-                    if(l)
-                    {
-                        put_char('?');
-                    }
-                    else
-                    {
-                        double d = va_arg(arg_list, double);
-                        num += print_float(d);
-                        str++;
-                    }
-                    break;
-                }
-                case 'e':
-                {
-                    if(l)
-                    {
-                        put_char('?');
-                    }
-                    else
-                    {
-                        double e = va_arg(arg_list, double);
-                        num += print_float_scientific(e);
-                        str++;
-                    }
-                    break;
-                }
-                case '%':
-                {
-                    if(l)
-                    {
-                        put_char('?');
-                        num++;
-                    }
-                    else
-                    {
-                        put_char('%');
-                        num++;
-                        str++;
-                    }
-                    break;
-                }
-                default:
-                {
-                    if(l) // unknown format specifier
-                    {
-                        put_char('?');
-                        num++;
-                    }
-                    else
-                    {
-                        put_char('%');
-                        num++;
-                    }
-                }
+                len = -1;
+                break;
             }
+            return chars < spec->width ? bytes + spec->width - chars : bytes;
         }
-        else
+        case 'c':
         {
-            int code = 0;
-            int bytes = decode_char(str, &code);
-            if(bytes > 0)
+            // the char is written as a unicode code, so past ascii it takes 2 bytes where char is unsigned and is
+            // invalid ('?') where it is signed, while the padding is counted in chars
+            char bytes[4];
+            len = encode_char((char)value.i, bytes);
+            len = len > 0 ? len : 1;
+            return spec->width > 1 ? len + spec->width - 1 : len;
+        }
+        case 'd':
+        {
+            len = int_to_chars(NULL, 0, value.i);
+            break;
+        }
+        case 'u':
+        {
+            len = unsigned_to_chars(NULL, 0, value.u);
+            break;
+        }
+        case 'b':
+        {
+            len = bin_to_chars(NULL, 0, value.u);
+            break;
+        }
+        case 'o':
+        {
+            len = oct_to_chars(NULL, 0, value.u);
+            break;
+        }
+        case 'h':
+        {
+            len = hex_to_chars(NULL, 0, value.u);
+            break;
+        }
+        case 'f':
+        {
+            len = spec->prec < 0 ? float_to_chars(NULL, 0, value.d, counter->sig_figs) : -1;
+            break;
+        }
+        case 'e':
+        {
+            len = spec->prec < 0 ? float_scientific_to_chars(NULL, 0, value.d, counter->sig_figs) : -1;
+            break;
+        }
+        default:
+        {
+            len = -1;
+            break;
+        }
+    }
+    if(len < 0)
+    {
+        int start = counter->utf8_length;
+        _format_value(counter, spec, value);
+        return counter->utf8_length - start;
+    }
+    return len > spec->width ? len : spec->width;
+}
+
+/*
+ * Returns the number of UTF-8 bytes str formats to with the arguments in arg_list (the same as
+ * yaos_vsnprintf_utf8 returns), without formatting it
+ * Text is counted as it is parsed and values from their digit counts, so it costs much less than formatting
+*/
+int yaos_vmeasure(const char* str, va_list arg_list)
+{
+    printf_ctx counter;
+    printf_ctx_init_utf8_buffer(&counter, NULL, 0);
+    int num = 0;
+    va_list args;
+    va_copy(args, arg_list);
+    while(*str != 0)
+    {
+        printf_op op;
+        str += yaos_parse_op(str, &op);
+        switch(op.type)
+        {
+            case PRINTF_OP_TEXT:
             {
-                put_char(code);
-                str += bytes;
+                num += op.len;
+                break;
             }
-            else
+            case PRINTF_OP_CODE:
             {
-                put_char('?'); // no idea what char encoded
-                str++;
+                // decode_char is as strict as the checks the formatter copies valid UTF-8 with, so a valid char
+                // encodes back to the bytes it was read from and an invalid byte is a '?'
+                char bytes[4];
+                int len = encode_char(op.len, bytes);
+                num += len > 0 ? len : 1;
+                break;
+            }
+            default:
+            {
+                printf_spec spec = op.spec;
+                if(spec.width == PRINTF_WIDTH_ARG)
+                {
+                    yaos_set_width(&spec, va_arg(args, int));
+                }
+                if(spec.prec == PRINTF_PREC_ARG)
+                {
+                    yaos_set_prec(&spec, va_arg(args, int));
+                }
+                num += _measure_value(&counter, &spec, yaos_read_arg(&spec, &args));
             }
-            num++;
         }
     }
+    va_end(args);
+    return num;
+}
+
+int yaos_measure(const char* str, ...)
+{
+    va_list arg_list;
+    va_start(arg_list, str);
+    int num = yaos_vmeasure(str, arg_list);
+    va_end(arg_list);
+    return num;
+}
+
+/*
+ * Formats str to the buffer set by set_buffer or to stdout if there is none
+*/
+int yaos_vprintf(const char* str, va_list arg_list)
+{
+    return yaos_vformat(&stdout_ctx, str, arg_list);
+}
+
+#ifdef TEST
+int my_printf(const char* str, ...)
+#else
+int printf(const char* str, ...)
+#endif
+{
+    va_list arg_list;
+    va_start(arg_list, str);
+    int num = yaos_vprintf(str, arg_list);
     va_end(arg_list);
     return num;
 }
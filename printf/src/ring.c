@@ -0,0 +1,329 @@
+// License GPL-2.0
+// Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+//
+// Unless required by applicable law or agreed to in writing, this software
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.
+
+#include <ring.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Sets up ring to use buffer, which holds size unicode chars (size must be a power of 2), with the consumer
+ * writing to out
+ * Messages are dropped when the ring is full until block is set
+*/
+void printf_ring_init(printf_ring* ring, int* buffer, uint32_t size, printf_ctx* out)
+{
+    memset(buffer, 0, size * sizeof(int));
+    ring->buffer = buffer;
+    ring->size = size;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->block = 0;
+    ring->single = 0;
+    ring->tail_seen = 0;
+    ring->dropped = 0;
+    ring->out = out;
+    ring->running = 0;
+}
+
+/*
+ * Formats a message and commits it whole to ring
+ * Safe to call from any number of threads at once
+ * Returns the number of chars in the message or -1 if it was dropped
+*/
+int printf_ring_vformat(printf_ring* ring, const char* str, va_list arg_list)
+{
+    int message[PRINTF_RING_MAX_MESSAGE];
+    printf_ctx ctx;
+    printf_ctx_init_buffer(&ctx, message, PRINTF_RING_MAX_MESSAGE);
+    ctx.sig_figs = ring->out->sig_figs;
+    yaos_vformat(&ctx, str, arg_list);
+    int len = ctx.buffer_index;
+    // a message (and its header) only ever takes half the ring so the skip to the start can't stop it fitting
+    if(len + 1 > (int)ring->size / 2)
+    {
+        len = ring->size / 2 - 1;
+    }
+
+    // reserve room for the message
+    uint32_t mask = ring->size - 1;
+    uint64_t head = __atomic_load_n(&(ring->head), __ATOMIC_RELAXED);
+    uint64_t tail = ring->single ? ring->tail_seen : __atomic_load_n(&(ring->tail), __ATOMIC_ACQUIRE);
+    uint32_t skip;
+    while(1)
+    {
+        uint32_t pos = head & mask;
+        skip = pos + len + 1 > ring->size ? ring->size - pos : 0;
+        uint64_t next = head + skip + len + 1;
+        if(next - tail > ring->size)
+        {
+            // the tail read before may be out of date, so the ring is only full if the current one says so
+            uint64_t current = __atomic_load_n(&(ring->tail), __ATOMIC_ACQUIRE);
+            if(current != tail)
+            {
+                tail = current;
+                continue;
+            }
+            if(!ring->block)
+            {
+                __atomic_fetch_add(&(ring->dropped), 1, __ATOMIC_RELAXED);
+                return -1;
+            }
+            sched_yield();
+            head = __atomic_load_n(&(ring->head), __ATOMIC_RELAXED);
+            tail = __atomic_load_n(&(ring->tail), __ATOMIC_ACQUIRE);
+            continue;
+        }
+        if(ring->single)
+        {
+            __atomic_store_n(&(ring->head), next, __ATOMIC_RELAXED);
+            ring->tail_seen = tail;
+            break;
+        }
+        if(__atomic_compare_exchange_n(&(ring->head), &head, next, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+            break;
+        }
+    }
+
+    // copy the message in then commit it
+    uint32_t pos = head & mask;
+    if(skip > 0)
+    {
+        __atomic_store_n(&(ring->buffer[pos]), -(int)skip, __ATOMIC_RELEASE);
+        pos = 0;
+    }
+    memcpy(&(ring->buffer[pos + 1]), message, len * sizeof(int));
+    __atomic_store_n(&(ring->buffer[pos]), len + 1, __ATOMIC_RELEASE);
+    return len;
+}
+
+int printf_ring_format(printf_ring* ring, const char* str, ...)
+{
+    va_list arg_list;
+    va_start(arg_list, str);
+    int len = printf_ring_vformat(ring, str, arg_list);
+    va_end(arg_list);
+    return len;
+}
+
+/*
+ * Internal function
+ * Writes the len unicode chars of message to out, passing runs of ascii chars to the sink together
+*/
+void _ring_write(printf_ctx* out, const int* message, int len)
+{
+    char run[64];
+    int i = 0;
+    while(i < len)
+    {
+        int n = 0;
+        while(i < len && n < 64 && message[i] >= 0 && message[i] < 0x80)
+        {
+            run[n] = message[i];
+            n++;
+            i++;
+        }
+        if(n > 0)
+        {
+            put_chars(out, run, n);
+        }
+        else
+        {
+            put_char(out, message[i]);
+            i++;
+        }
+    }
+}
+
+/*
+ * Writes every committed message at the tail of ring to ring->out, stopping at the first uncommitted one
+ * Must only be called from one thread at a time
+ * Returns the number of chars written
+*/
+int printf_ring_drain(printf_ring* ring)
+{
+    uint32_t mask = ring->size - 1;
+    uint64_t tail = ring->tail;
+    int num = 0;
+    while(1)
+    {
+        int* slot = &(ring->buffer[tail & mask]);
+        int header = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+        if(header == 0)
+        {
+            break;
+        }
+        int used;
+        if(header < 0)
+        {
+            used = -header;
+        }
+        else
+        {
+            _ring_write(ring->out, slot + 1, header - 1);
+            num += header - 1;
+            used = header;
+        }
+        // slots are cleared before being handed back so a header is never read from an old message
+        memset(slot, 0, used * sizeof(int));
+        tail += used;
+        __atomic_store_n(&(ring->tail), tail, __ATOMIC_RELEASE);
+    }
+    return num;
+}
+
+/*
+ * Internal function
+ * Drain thread, yielding while the ring is empty and draining what is left once stopped
+*/
+void* _ring_thread(void* data)
+{
+    printf_ring* ring = (printf_ring*)data;
+    while(__atomic_load_n(&(ring->running), __ATOMIC_ACQUIRE))
+    {
+        uint64_t tail = ring->tail;
+        printf_ring_drain(ring);
+        if(ring->tail == tail)
+        {
+            sched_yield();
+        }
+    }
+    printf_ring_drain(ring);
+    return NULL;
+}
+
+/*
+ * Starts a thread draining ring
+ * Returns 0 on success or the pthread_create error
+*/
+int printf_ring_start(printf_ring* ring)
+{
+    __atomic_store_n(&(ring->running), 1, __ATOMIC_RELEASE);
+    int err = pthread_create(&(ring->thread), NULL, _ring_thread, ring);
+    if(err != 0)
+    {
+        ring->running = 0;
+    }
+    return err;
+}
+
+/*
+ * Stops the drain thread once it has written every message committed so far
+*/
+void printf_ring_stop(printf_ring* ring)
+{
+    if(!ring->running)
+    {
+        return;
+    }
+    __atomic_store_n(&(ring->running), 0, __ATOMIC_RELEASE);
+    pthread_join(ring->thread, NULL);
+}
+
+/*
+ * Sets up set with num_rings rings (up to PRINTF_RING_MAX_PRODUCERS) of ring_size slots each (a power of 2),
+ * taken one after the other from buffer, with the consumer writing to out
+*/
+void printf_ring_set_init(printf_ring_set* set, int* buffer, uint32_t ring_size, int num_rings, printf_ctx* out)
+{
+    if(num_rings > PRINTF_RING_MAX_PRODUCERS)
+    {
+        num_rings = PRINTF_RING_MAX_PRODUCERS;
+    }
+    for(int i = 0; i < num_rings; i++)
+    {
+        printf_ring_init(&(set->rings[i]), &(buffer[i * ring_size]), ring_size, out);
+        set->rings[i].single = 1;
+    }
+    set->num_rings = num_rings;
+    set->joined = 0;
+    set->block = 0;
+    set->running = 0;
+}
+
+/*
+ * Takes a ring of set for the calling thread, which must be the only thread formatting to it
+ * Returns the ring or NULL if every ring has been taken
+*/
+printf_ring* printf_ring_set_join(printf_ring_set* set)
+{
+    int id = __atomic_load_n(&(set->joined), __ATOMIC_RELAXED);
+    do
+    {
+        if(id >= set->num_rings)
+        {
+            return NULL;
+        }
+    } while(!__atomic_compare_exchange_n(&(set->joined), &id, id + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    set->rings[id].block = set->block;
+    return &(set->rings[id]);
+}
+
+/*
+ * Writes every committed message in each ring of set to the output context, a ring at a time
+ * Must only be called from one thread at a time
+ * Returns the number of chars written
+*/
+int printf_ring_set_drain(printf_ring_set* set)
+{
+    int num = 0;
+    for(int i = 0; i < set->num_rings; i++)
+    {
+        num += printf_ring_drain(&(set->rings[i]));
+    }
+    return num;
+}
+
+/*
+ * Internal function
+ * Drain thread for a set, yielding while every ring is empty and draining what is left once stopped
+*/
+void* _ring_set_thread(void* data)
+{
+    printf_ring_set* set = (printf_ring_set*)data;
+    while(__atomic_load_n(&(set->running), __ATOMIC_ACQUIRE))
+    {
+        if(printf_ring_set_drain(set) == 0)
+        {
+            sched_yield();
+        }
+    }
+    printf_ring_set_drain(set);
+    return NULL;
+}
+
+/*
+ * Starts a thread draining every ring of set
+ * Returns 0 on success or the pthread_create error
+*/
+int printf_ring_set_start(printf_ring_set* set)
+{
+    __atomic_store_n(&(set->running), 1, __ATOMIC_RELEASE);
+    int err = pthread_create(&(set->thread), NULL, _ring_set_thread, set);
+    if(err != 0)
+    {
+        set->running = 0;
+    }
+    return err;
+}
+
+/*
+ * Stops the drain thread once it has written every message committed so far
+*/
+void printf_ring_set_stop(printf_ring_set* set)
+{
+    if(!set->running)
+    {
+        return;
+    }
+    __atomic_store_n(&(set->running), 0, __ATOMIC_RELEASE);
+    pthread_join(set->thread, NULL);
+}
@@ -7,9 +7,23 @@
 
 #include <printf.h>
 #ifdef TEST
+#include <deferred.h>
+#include <ring.h>
+#include <iov.h>
+#include <args.h>
+#include <stream.h>
+#include <async.h>
+#include <asprintf.h>
+#include <schubfach.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <munit.h>
 #include <malloc.h>
+#include <stdlib.h>
 #include <assert.h>
+#include <stdint.h>
+#include <stdarg.h>
 #endif
 
 #ifdef TEST
@@ -125,7 +139,8 @@ void test_float_general()
     test_float(23e20f, "2300000000000000000000");
     test_float(11.0f, "11");
     test_float(5.0f, "5");
-    test_float(2.34185f, "2.3418");
+    // 2.34185f is 2.34185004... so it rounds up (unlike the double 2.34185, which is just below the tie)
+    test_float(2.34185f, "2.3419");
     test_float(1.0f, "1");
     test_float(10.0829f, "10.083");
     test_float(-0.1f, "-0.10000");
@@ -136,7 +151,7 @@ void test_float_general()
     test_float(-23e20f, "-2300000000000000000000");
     test_float(-11.0f, "-11");
     test_float(-5.0f, "-5");
-    test_float(-2.34185f, "-2.3418");
+    test_float(-2.34185f, "-2.3419");
     test_float(-1.0f, "-1");
     test_float(-10.0829f, "-10.083");
 }
@@ -282,6 +297,1137 @@ void test_double_subnormal()
     test_float(-2.22507e-308, small_double);
 }
 
+/*
+ * Checks buffer holds the unicode chars of the ascii string expected followed by a 0 terminator
+*/
+void check_int_str(const int* buffer, const char* expected)
+{
+    int len = strlen(expected);
+    int* res_buffer = (int*)malloc((len + 1) * sizeof(int));
+    assert(put_str_in_int_buffer(expected, res_buffer, len) == len);
+    res_buffer[len] = 0;
+    munit_assert_memory_equal((len + 1) * sizeof(int), res_buffer, buffer);
+    free(res_buffer);
+}
+
+/*
+ * Tests the snprintf style functions write to the given buffer, truncate and return the full length
+*/
+void test_snprintf()
+{
+    int out[16];
+    munit_assert_int(yaos_snprintf(out, 16, "%d %s", -42, "abc"), ==, 7);
+    check_int_str(out, "-42 abc");
+    munit_assert_int(yaos_snprintf(out, 6, "%h-%d", 0xbeef, 12345), ==, 12);
+    check_int_str(out, "0xbee");
+    munit_assert_int(yaos_snprintf(out, 1, "%f", 1.5), ==, 3);
+    check_int_str(out, "");
+    munit_assert_int(yaos_snprintf(NULL, 0, "%ld", (int64_t)1 << 40), ==, 13);
+
+    // two contexts being written to at the same time don't affect each other
+    int a[16];
+    int b[16];
+    printf_ctx ctx_a;
+    printf_ctx ctx_b;
+    printf_ctx_init_buffer(&ctx_a, a, 16);
+    printf_ctx_init_buffer(&ctx_b, b, 16);
+    yaos_format(&ctx_a, "a=%d ", 1);
+    yaos_format(&ctx_b, "b=%u ", 2);
+    yaos_format(&ctx_a, "%e", 10.0);
+    a[ctx_a.buffer_index] = 0;
+    b[ctx_b.buffer_index] = 0;
+    check_int_str(a, "a=1 1e1");
+    check_int_str(b, "b=2 ");
+}
+
+/*
+ * Checks the printed output of format with the arguments given is the ascii string expected
+*/
+void check_format(const char* expected, const char* format, ...)
+{
+    int out[BUFFER_LENGTH];
+    va_list arg_list;
+    va_start(arg_list, format);
+    munit_assert_int(yaos_vsnprintf(out, BUFFER_LENGTH, format, arg_list), ==, (int)strlen(expected));
+    va_end(arg_list);
+    check_int_str(out, expected);
+}
+
+/*
+ * Tests the significant figures set in a context, including the shortest round trip digits
+*/
+void test_sig_figs()
+{
+    int out[BUFFER_LENGTH];
+    printf_ctx ctx;
+    printf_ctx_init_buffer(&ctx, out, BUFFER_LENGTH);
+    munit_assert_int(ctx.sig_figs, ==, PRINTF_SIG_FIGS);
+    ctx.sig_figs = 3;
+    yaos_format(&ctx, "%f %f %f %e %f|", 2.345, 2.355, 9.9999, 9.9999, 0.123456);
+    ctx.sig_figs = PRINTF_SHORTEST;
+    yaos_format(&ctx, "%f %e %e %e|", 1.0 / 3, 0.1, 5e-324, 1.7976931348623157e308);
+    ctx.sig_figs = 1;
+    yaos_format(&ctx, "%f %f %e", 0.25, 0.35, 950.0);
+    out[ctx.buffer_index] = 0;
+    check_int_str(out, "2.34 2.36 10.0 1.00e1 0.123|0.3333333333333333 1e-1 5e-324 1.7976931348623157e308|0.2 0.4 1e3");
+
+    // printf keeps its setting when its output changes
+    set_sig_figs(2);
+    set_buffer(out, BUFFER_LENGTH);
+    my_printf("%f", 3.14159);
+    set_sig_figs(PRINTF_SIG_FIGS);
+    munit_assert_int(out[0], ==, '3');
+    munit_assert_int(out[2], ==, '1');
+    munit_assert_int(get_stdout_ctx()->buffer_index, ==, 3);
+}
+
+/*
+ * Tests %.Nf and %.Ne give correctly rounded digits, including ties, carries and large precisions
+*/
+void test_float_precision()
+{
+    check_format("0.12 0.38 2 0 2 1e1", "%.2f %.2f %.0f %.0f %.f %.0e", 0.125, 0.375, 2.5, 0.5, 1.5, 9.5);
+    check_format("10.000 -0.000 0.00e0 -1.0e0", "%.3f %.3f %.2e %.1e", 9.9996, -0.0001, 0.0, -0.996);
+    check_format("0.1000000000000000055511151231257827", "%.34f", 0.1);
+    check_format("1.2345678901234568e-5 3.14159e2", "%.16e %.5e", 1.2345678901234567e-5, 314.159);
+    check_format("4.94065645841246544e-324 INF -INF", "%.17e %.3f %.3e", 5e-324, 1.0 / 0.0, -1.0 / 0.0);
+    check_format("1797693134862315708145274237317043567980705675258449965989174768031572607800285387605895586327668"
+        "78171540458953514382464234321326889464182768467546703537516986049910576551282076245490090389328944075868"
+        "50845513394230458323690322294816580855933212334827479782620414472316873817718091929988125040402618412485"
+        "8368.0", "%.1f", 1.7976931348623157e308);
+    check_format("%.2d ?c ?h", "%%.2d %.2c %.1lh");
+    // tiny values, which round to 0 or only need their first few digits
+    check_format("0.00|-0.00|0|1.000e-300|1.000e-10|4.94066e-324", "%.2f|%.2f|%.0f|%.3e|%.3e|%.5e", 1e-300, -1e-100,
+        0.4999999999999999, 1e-300, 1e-10, 5e-324);
+    check_format("1.000000000000000025059091835209e-300", "%.30e", 1e-300);
+    // 5e-22 is just under 0.5e-21 so only rounds up past 21 digits
+    check_format("0.000000000000000000000|0.0000000000000000000005|0.0000000000000000000005000", "%.21f|%.22f|%.25f",
+        5e-22, 5e-22, 5e-22);
+
+    int out[1100];
+    munit_assert_int(yaos_snprintf(out, 1100, "%.1074f", 5e-324), ==, 1076);
+    // the last fraction digit of the smallest subnormal is 5 and the 324th is the first which isn't 0
+    munit_assert_int(out[1075], ==, '5');
+    munit_assert_int(out[325], ==, '4');
+    munit_assert_int(out[324], ==, '0');
+    munit_assert_int(yaos_snprintf(NULL, 0, "%.2000f", 1.0), ==, 2002);
+}
+
+/*
+ * Tests widths, zero fill and left alignment, including widths taken from * arguments
+*/
+void test_width()
+{
+    check_format("   42|42   |00042|-0042|12345|42   ", "%5d|%-5d|%05d|%05d|%3d|%-05d", 42, 42, 42, -42, 12345, 42);
+    check_format("0x0000be|0xbe    |   0b101|0o00000010", "%08h|%-8h|%8b|%010o", 0xbe, 0xbe, 5, 8);
+    check_format("    -7|3   |9   |", "%*d|%-*d|%*u|", 6, -7, 4, 3, -4, 9);
+    // strings are padded by their char count, and never with zeros
+    check_format("ab    |     x|long|  a|b  ", "%-6s|%06s|%3s|%3c|%-3c", "ab", "x", "long", 'a', 'b');
+    munit_assert_int(yaos_snprintf(NULL, 0, "%6s|%-6s", "\xc3\xa9t\xc3\xa9", "\xc3\xa9t\xc3\xa9"), ==, 13);
+    check_format("    3.1416|3.1416    |-0003.1416|     1e-10", "%10f|%-10f|%010f|%10e", 3.14159, 3.14159, -3.14159,
+        1e-10);
+    check_format("-001.500|   1.23e4|0.0e0    |  -0.00", "%08.3f|%9.2e|%-9.1e|%7.2f", -1.5, 12345.678, 0.0, -0.001);
+    check_format("   INF|-INF  |  -INF", "%06f|%-6e|%06.2f", 1.0 / 0.0, -1.0 / 0.0, -1.0 / 0.0);
+    // invalid specifiers with a width print '?' and take no argument, even with *
+    check_format("?q ?f ?q 7", "%-q %5lf %*q %d", 7);
+    munit_assert_int(yaos_snprintf(NULL, 0, "%*d", 100000, 1), ==, PRINTF_MAX_WIDTH);
+}
+
+/*
+ * Tests strings printed with a precision or a known length, which needn't end in a NUL
+*/
+void test_string_slices()
+{
+    const char slice[6] = {'h', 'e', 'l', 'l', 'o', '!'}; // no NUL
+    check_format("hel|hello|hello!|ab|", "%.3s|%.*s|%.6s|%.5s|%.0s", slice, 5, slice, slice, "ab", "x");
+    check_format("  hel|hel  |hello|  he|", "%5.3s|%-5.3s|%.*s|%*.*s|", slice, slice, -1, "hello", 4, 2, slice);
+    // the precision counts bytes, so a UTF-8 char cut in half is invalid
+    check_format("a?|a", "%.2s|%.1s", "a\xc3\xa9", "a\xc3\xa9");
+    munit_assert_int(yaos_snprintf(NULL, 0, "%.3s|%5.3s", "a\xc3\xa9", "a\xc3\xa9"), ==, 8);
+    check_format("2.50 1.2e3 ?d", "%.*f %.*e %.*d", 2, 2.5, 1, 1234.0);
+
+    // print_string_n prints NULs within the string like any other char
+    int out[16];
+    printf_ctx ctx;
+    printf_ctx_init_buffer(&ctx, out, 16);
+    munit_assert_int(print_string_n(&ctx, "ab\0c\xff", 5), ==, 5);
+    munit_assert_int(out[2], ==, 0);
+    out[2] = '0';
+    out[5] = 0;
+    check_int_str(out, "ab0c?");
+    char utf8[16];
+    printf_ctx_init_utf8_buffer(&ctx, utf8, 16);
+    printf_spec spec = {'s', 0, -1, PRINTF_FLAG_LEFT, 4};
+    munit_assert_int(yaos_format_string(&ctx, &spec, "\xc3\xa9t\xc3", 4), ==, 4);
+    munit_assert_int(ctx.buffer_index, ==, 5);
+    munit_assert_memory_equal(5, utf8, "\xc3\xa9t? ");
+}
+
+/*
+ * Tests the UTF-8 output mode copies valid UTF-8 through, replaces invalid bytes and only writes whole chars
+*/
+void test_utf8()
+{
+    char out[64];
+    const char* expected = "t\xc3\xa9st?|x|\xe2\x82\xac" "5|    \xc3\xa9|\xf0\x9f\x98\x80";
+    munit_assert_int(yaos_snprintf_utf8(out, 64, "%s|%c|\xe2\x82\xac%d|%5s|%s", "t\xc3\xa9st\xff", 'x', 5, "\xc3\xa9",
+        "\xf0\x9f\x98\x80"), ==, (int)strlen(expected));
+    munit_assert_string_equal(out, expected);
+    munit_assert_int(yaos_snprintf_utf8(NULL, 0, "\xe2\x82\xac%s", "\xc3\xa9"), ==, 5);
+
+    // a %c byte from 0x80 up isn't a whole UTF-8 char so it prints as '?', while a unicode char buffer still gets
+    // the char's value
+    munit_assert_int(yaos_snprintf_utf8(out, 64, "%c|%3c", '\xe9', '\x80'), ==, 5);
+    munit_assert_string_equal(out, "?|  ?");
+    int codes[2];
+    munit_assert_int(yaos_snprintf(codes, 2, "%c", '\xe9'), ==, 1);
+    munit_assert_int(codes[0], ==, '\xe9');
+
+    // a char which doesn't fit is dropped whole, along with everything after it
+    memset(out, '#', 8);
+    munit_assert_int(yaos_snprintf_utf8(out, 4, "a\xe2\x82\xac" "b"), ==, 5);
+    munit_assert_string_equal(out, "a");
+    munit_assert_int(yaos_snprintf_utf8(out, 5, "%d\xc3\xa9%s", 12, "\xc3\xa9"), ==, 6);
+    munit_assert_string_equal(out, "12\xc3\xa9");
+
+    // compiled format strings encode their unicode chars, and the count returned is still in chars
+    printf_op ops[8];
+    int num_ops = yaos_compile("\xc3\xa9%s\xe2\x82\xac", ops, 8);
+    printf_ctx ctx;
+    printf_ctx_init_utf8_buffer(&ctx, out, 64);
+    munit_assert_int(yaos_format_compiled(&ctx, ops, num_ops, "\xce\xb1\xff"), ==, 4);
+    munit_assert_int(ctx.buffer_index, ==, 8);
+    munit_assert_memory_equal(8, out, "\xc3\xa9\xce\xb1?\xe2\x82\xac");
+
+    // overlong forms, surrogates and codes above 0x10ffff are invalid a byte at a time, the same in the format
+    // string (cached or not) as in a %s argument
+    const char* invalid[] = {"\xc0\xaf", "\xe0\x80\xaf", "\xed\xa0\x80", "\xf0\x80\x80\xaf", "\xf4\x90\x80\x80",
+        "\xf7\xbf\xbf\xbf"};
+    printf_cache cache;
+    printf_cache_init(&cache);
+    printf_stats stats;
+    printf_stats_init(&stats);
+    char formats[6][16];
+    for(int i = 0; i < (int)(sizeof(invalid) / sizeof(invalid[0])); i++)
+    {
+        int bytes = strlen(invalid[i]);
+        int chars;
+        munit_assert_int(valid_utf8_length(invalid[i], bytes, &chars), ==, 0);
+        // the cache goes by the address of the format string, so each one needs its own
+        char* format = formats[i];
+        char expected_out[16];
+        strcpy(format, "a");
+        strcat(format, invalid[i]);
+        strcat(format, "z");
+        strcpy(expected_out, "a????");
+        strcpy(&(expected_out[1 + bytes]), "z");
+        int len = bytes + 2;
+        munit_assert_int(yaos_snprintf_utf8(out, 64, format), ==, len);
+        munit_assert_string_equal(out, expected_out);
+        munit_assert_int(yaos_snprintf_utf8(out, 64, "%s", format), ==, len);
+        munit_assert_string_equal(out, expected_out);
+        munit_assert_int(yaos_snprintf_utf8(out, 64, "%.*s", len, format), ==, len);
+        munit_assert_string_equal(out, expected_out);
+        for(int j = 0; j < 2; j++)
+        {
+            printf_ctx_init_utf8_buffer(&ctx, out, 64);
+            ctx.cache = &cache;
+            ctx.stats = &stats;
+            munit_assert_int(yaos_format(&ctx, format), ==, len);
+            munit_assert_int(ctx.buffer_index, ==, len);
+            munit_assert_memory_equal(len, out, expected_out);
+        }
+        int wide[16];
+        munit_assert_int(yaos_snprintf(wide, 16, format), ==, len);
+        check_int_str(wide, expected_out);
+    }
+    munit_assert_int(cache.misses, ==, 6);
+    munit_assert_int(cache.hits, ==, 6);
+    munit_assert_int(stats.invalid_utf8, ==, 2 * (2 + 3 + 3 + 4 + 4 + 4));
+
+    // the chars either side of those ranges are valid
+    const char* edges = "\xc2\x80\xe0\xa0\x80\xed\x9f\xbf\xee\x80\x80\xf0\x90\x80\x80\xf4\x8f\xbf\xbf";
+    int chars;
+    munit_assert_int(valid_utf8_length(edges, strlen(edges), &chars), ==, (int)strlen(edges));
+    munit_assert_int(chars, ==, 6);
+    munit_assert_int(yaos_snprintf_utf8(out, 64, edges), ==, (int)strlen(edges));
+    munit_assert_string_equal(out, edges);
+    munit_assert_int(yaos_snprintf_utf8(out, 64, "%s", edges), ==, (int)strlen(edges));
+    munit_assert_string_equal(out, edges);
+}
+
+/*
+ * Prints val with print_float32 (or print_float32_scientific) to ctx and checks the output is expected
+*/
+void check_float32(printf_ctx* ctx, float val, int scientific, const char* expected)
+{
+    ctx->buffer_index = 0;
+    int n = scientific ? print_float32_scientific(ctx, val) : print_float32(ctx, val);
+    munit_assert_int(n, ==, (int)strlen(expected));
+    ctx->buffer[n] = 0;
+    check_int_str(ctx->buffer, expected);
+}
+
+/*
+ * Checks the first len chars of buffer are the text expected
+*/
+void check_chars(const char* buffer, int len, const char* expected)
+{
+    munit_assert_int(len, ==, (int)strlen(expected));
+    munit_assert_memory_equal(len, buffer, expected);
+}
+
+/*
+ * Tests the to_chars functions write the same text as printf into a char buffer, and nothing when it doesn't fit
+*/
+void test_to_chars()
+{
+    char buffer[PRINTF_FLOAT_CHARS];
+    check_chars(buffer, int_to_chars(buffer, PRINTF_INT_CHARS, INT64_MIN), "-9223372036854775808");
+    check_chars(buffer, int_to_chars(buffer, PRINTF_INT_CHARS, 0), "0");
+    check_chars(buffer, unsigned_to_chars(buffer, PRINTF_INT_CHARS, UINT64_MAX), "18446744073709551615");
+    check_chars(buffer, hex_to_chars(buffer, PRINTF_HEX_CHARS, UINT64_MAX), "0xffffffffffffffff");
+    check_chars(buffer, oct_to_chars(buffer, PRINTF_OCT_CHARS, UINT64_MAX), "0o1777777777777777777777");
+    munit_assert_int(bin_to_chars(buffer, PRINTF_BIN_CHARS, UINT64_MAX), ==, PRINTF_BIN_CHARS);
+    check_chars(buffer, bin_to_chars(buffer, PRINTF_BIN_CHARS, 5), "0b101");
+    check_chars(buffer, float_to_chars(buffer, PRINTF_FLOAT_CHARS, -23.7895, 5), "-23.790");
+    check_chars(buffer, float_to_chars(buffer, PRINTF_FLOAT_CHARS, 0.1, PRINTF_SHORTEST), "0.1");
+    check_chars(buffer, float_to_chars(buffer, PRINTF_FLOAT_CHARS, -0.0, 5), "-0");
+    check_chars(buffer, float_to_chars(buffer, PRINTF_FLOAT_CHARS, 4.59e10, 5), "45900000000");
+    check_chars(buffer, float_scientific_to_chars(buffer, PRINTF_FLOAT_SCIENTIFIC_CHARS, 0.0, 5), "0e0");
+    check_chars(buffer, float_scientific_to_chars(buffer, PRINTF_FLOAT_SCIENTIFIC_CHARS, -1.0 / 0.0, 5), "-INF");
+    check_chars(buffer, float_scientific_to_chars(buffer, PRINTF_FLOAT_SCIENTIFIC_CHARS,
+        -2.2250738585072014e-308, PRINTF_SHORTEST), "-2.2250738585072014e-308");
+    // the longest texts fit in the sizes given in printf.h
+    munit_assert_int(float_to_chars(buffer, PRINTF_FLOAT_CHARS, -2.2250738585072014e-308, PRINTF_SHORTEST), <=,
+        PRINTF_FLOAT_CHARS);
+    munit_assert_int(float_to_chars(buffer, PRINTF_FLOAT_CHARS, -1.7976931348623157e308, PRINTF_SHORTEST), ==, 310);
+
+    // too small: the length is still returned but nothing is written
+    memset(buffer, '#', 8);
+    munit_assert_int(int_to_chars(buffer, 3, -1234), ==, 5);
+    munit_assert_int(hex_to_chars(buffer, 2, 0xab), ==, 4);
+    munit_assert_int(float_to_chars(buffer, 4, 3.14159, 5), ==, 6);
+    munit_assert_int(float_scientific_to_chars(buffer, 0, 1e-300, 5), ==, 6);
+    check_chars(buffer, 8, "########");
+}
+
+/*
+ * Checks both float to decimal engines give the same digits for the double with the bits given
+*/
+void check_engines(uint64_t bits)
+{
+    uint64_t man = bits & 0xfffffffffffffull;
+    uint32_t exp = (bits >> 52) & 0x7ff;
+    floating_decimal_64 ryu = d2d(man, exp);
+    floating_decimal_64 schubfach = schubfach_d2d(man, exp);
+    munit_assert_uint64(ryu.mantissa, ==, schubfach.mantissa);
+    munit_assert_int(ryu.exponent, ==, schubfach.exponent);
+}
+
+/*
+ * Tests Ryu and Schubfach agree bit for bit on every exponent (including powers of 2 and the smallest
+ * subnormals) and on random doubles
+*/
+void test_float_engines()
+{
+    for(uint64_t exp = 0; exp < 0x7ff; exp++)
+    {
+        for(uint64_t man = 0; man < 64; man++)
+        {
+            if(exp != 0 || man != 0)
+            {
+                check_engines(exp << 52 | man);
+            }
+            check_engines(exp << 52 | (0xfffffffffffffull - man));
+        }
+    }
+    uint64_t bits = 1;
+    for(int i = 0; i < 1000000; i++)
+    {
+        bits ^= bits << 13;
+        bits ^= bits >> 7;
+        bits ^= bits << 17;
+        if(((bits >> 52) & 0x7ff) != 0x7ff && (bits & 0x7fffffffffffffffull) != 0)
+        {
+            check_engines(bits);
+        }
+    }
+    // short decimals, where the shortest digits are much shorter than 17
+    const double short_values[] = {0.3, 1e23, 5e-324, 1e-323, 9007199254740992.0, 123456.0, 2.2250738585072014e-308};
+    for(unsigned int i = 0; i < sizeof(short_values) / sizeof(short_values[0]); i++)
+    {
+        uint64_t value_bits;
+        memcpy(&value_bits, &short_values[i], sizeof(double));
+        check_engines(value_bits);
+    }
+}
+
+/*
+ * Tests the 32 bit float path gives the shortest digits of the float itself and that they round trip
+*/
+void test_float32()
+{
+    int out[BUFFER_LENGTH];
+    printf_ctx ctx;
+    printf_ctx_init_buffer(&ctx, out, BUFFER_LENGTH);
+    ctx.sig_figs = PRINTF_SHORTEST;
+    // widened to a double these would be 0.10000000149011612 and 2.3418500423431396
+    check_float32(&ctx, 0.1f, 0, "0.1");
+    check_float32(&ctx, 2.34185f, 0, "2.34185");
+    check_float32(&ctx, -23.789f, 0, "-23.789");
+    check_float32(&ctx, 4.59e10f, 0, "45900000000");
+    check_float32(&ctx, 1e-45f, 1, "1e-45");
+    check_float32(&ctx, 3.4028235e38f, 1, "3.4028235e38");
+    check_float32(&ctx, -0.0f, 1, "-0e0");
+    check_float32(&ctx, 1.0f / 0.0f, 0, "INF");
+    ctx.sig_figs = PRINTF_SIG_FIGS;
+    check_float32(&ctx, 0.1f, 0, "0.1");
+    // digits cut to PRINTF_SIG_FIGS round from the exact value, and 2.34185f is just above the tie
+    check_float32(&ctx, 2.34185f, 0, "2.3419");
+    check_float32(&ctx, 19.27845f, 1, "1.9278e1");
+    // so they have the same value as the c standard library gives the float to that many figures
+    char str[32];
+    char wide_str[32];
+    for(float val = 1.0f; val < 2.0f; val += 1e-5f)
+    {
+        for(int scientific = 0; scientific < 2; scientific++)
+        {
+            ctx.buffer_index = 0;
+            int n = scientific ? print_float32_scientific(&ctx, val) : print_float32(&ctx, val);
+            for(int j = 0; j < n; j++)
+            {
+                str[j] = out[j];
+            }
+            str[n] = 0;
+            munit_assert_int(snprintf(wide_str, 32, "%.*g", PRINTF_SIG_FIGS, (double)val), <, 32);
+            munit_assert_true(strtod(str, NULL) == strtod(wide_str, NULL));
+        }
+    }
+
+    // spread of bit patterns over every exponent, checked to round trip through strtof
+    ctx.sig_figs = PRINTF_SHORTEST;
+    uint32_t bits = 1;
+    for(int i = 0; i < 100000; i++)
+    {
+        bits = bits * 1664525u + 1013904223u;
+        uint32_t pos_bits = bits % 0x7f800000u;
+        float val;
+        memcpy(&val, &pos_bits, sizeof(float));
+        ctx.buffer_index = 0;
+        int n = print_float32_scientific(&ctx, val);
+        char str[32];
+        for(int j = 0; j < n; j++)
+        {
+            str[j] = out[j];
+        }
+        str[n] = 0;
+        float back = strtof(str, NULL);
+        munit_assert_memory_equal(sizeof(float), &val, &back);
+    }
+}
+
+/*
+ * Tests decimal integers around every change in digit count as well as the limits
+*/
+void test_int()
+{
+    char expected[32];
+    uint64_t p = 1;
+    for(int i = 0; i < 20; i++)
+    {
+        snprintf(expected, 32, "%lu", p - 1);
+        check_format(expected, "%lu", p - 1);
+        snprintf(expected, 32, "%lu", p);
+        check_format(expected, "%lu", p);
+        snprintf(expected, 32, "%lu", p + 1);
+        check_format(expected, "%lu", p + 1);
+        snprintf(expected, 32, "%ld", -(int64_t)p);
+        check_format(expected, "%ld", -(int64_t)p);
+        snprintf(expected, 32, "%u", (uint32_t)p);
+        check_format(expected, "%u", (uint32_t)p);
+        snprintf(expected, 32, "%d", (int32_t)(0 - p));
+        check_format(expected, "%d", (int32_t)(0 - p));
+        p *= 10;
+    }
+    check_format("18446744073709551615", "%lu", UINT64_MAX);
+    check_format("-9223372036854775808", "%ld", INT64_MIN);
+    check_format("9223372036854775807", "%ld", INT64_MAX);
+    check_format("-2147483648", "%d", INT32_MIN);
+    check_format("4294967295", "%u", UINT32_MAX);
+}
+
+/*
+ * Reference conversion for binary, octal and hex taken from the original bit group by bit group printf code
+ * bits is the number of bits per digit and prefix the char after the leading '0'
+*/
+void ref_print_pow2(uint64_t val, int bits, char prefix, char* out)
+{
+    char data[64];
+    int end = 63;
+    while(val > 0)
+    {
+        int digit = val & ((1 << bits) - 1);
+        if(digit < 10)
+        {
+            data[end] = digit + '0';
+        }
+        else
+        {
+            data[end] = (digit - 10) + 'a';
+        }
+        val >>= bits;
+        end--;
+    }
+    end++;
+    *out++ = '0';
+    *out++ = prefix;
+    if(end == 64)
+    {
+        *out++ = '0';
+    }
+    for(; end < 64; end++)
+    {
+        *out++ = data[end];
+    }
+    *out = 0;
+}
+
+/*
+ * Checks %b, %o and %h (32 and 64 bit) of val against the reference conversion
+*/
+void check_pow2(uint64_t val)
+{
+    char expected[72];
+    ref_print_pow2(val, 1, 'b', expected);
+    check_format(expected, "%lb", val);
+    ref_print_pow2(val, 3, 'o', expected);
+    check_format(expected, "%lo", val);
+    ref_print_pow2(val, 4, 'x', expected);
+    check_format(expected, "%lh", val);
+    ref_print_pow2((uint32_t)val, 1, 'b', expected);
+    check_format(expected, "%b", (uint32_t)val);
+    ref_print_pow2((uint32_t)val, 3, 'o', expected);
+    check_format(expected, "%o", (uint32_t)val);
+    ref_print_pow2((uint32_t)val, 4, 'x', expected);
+    check_format(expected, "%h", (uint32_t)val);
+}
+
+/*
+ * Differential test of binary, octal and hex output against the reference conversion
+ * Covers every bit length, all ones values and a run of pseudo random values
+*/
+void test_pow2()
+{
+    check_pow2(0);
+    for(int i = 0; i < 64; i++)
+    {
+        uint64_t bit = (uint64_t)1 << i;
+        check_pow2(bit);
+        check_pow2(bit - 1);
+        check_pow2(bit | (bit - 1) | 1);
+        check_pow2(~(bit - 1));
+    }
+    uint64_t x = 88172645463325252ull;
+    for(int i = 0; i < 100000; i++)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        check_pow2(x >> (x & 63));
+    }
+}
+
+/*
+ * Tests literal text is copied correctly when a format specifier or non-ascii char is at any position
+ * and the text starts at any alignment
+*/
+void test_literal()
+{
+    char storage[64];
+    char expected[64];
+    int out[64];
+    for(int align = 0; align < 8; align++)
+    {
+        char* format = &(storage[align]);
+        for(int pos = 0; pos < 40; pos++)
+        {
+            // format specifier at pos
+            memset(format, 'a', 41);
+            memcpy(&(format[pos]), "%d", 2);
+            format[41] = 0;
+            memset(expected, 'a', 40);
+            expected[pos] = '7';
+            expected[40] = 0;
+            check_format(expected, format, 7);
+
+            // 2 byte utf-8 char at pos
+            memset(format, 'b', 41);
+            memcpy(&(format[pos]), "\xc3\xa9", 2);
+            format[41] = 0;
+            munit_assert_int(yaos_snprintf(out, 64, format), ==, 40);
+            for(int i = 0; i < 40; i++)
+            {
+                munit_assert_int(out[i], ==, i == pos ? 0xe9 : 'b');
+            }
+            munit_assert_int(out[40], ==, 0);
+        }
+    }
+}
+
+/*
+ * Tests compiled format strings and the format cache give the same output as parsing the format string
+*/
+void test_compiled()
+{
+    const char* format = "%d%% %lh \xc3\xa9 %s %q %lf %e\xff";
+    int expected[64];
+    int out[64];
+    int len = yaos_snprintf(expected, 64, format, -5, (uint64_t)0xabc, "str", 2.5);
+
+    printf_op ops[16];
+    int num_ops = yaos_compile(format, ops, 16);
+    munit_assert_int(num_ops, <=, 16);
+    munit_assert_int(yaos_compile(format, ops, 2), ==, num_ops);
+    printf_ctx ctx;
+    printf_ctx_init_buffer(&ctx, out, 64);
+    munit_assert_int(yaos_format_compiled(&ctx, ops, num_ops, -5, (uint64_t)0xabc, "str", 2.5), ==, len);
+    munit_assert_memory_equal(len * sizeof(int), expected, out);
+
+    printf_cache* cache = (printf_cache*)malloc(sizeof(printf_cache));
+    printf_cache_init(cache);
+    for(int i = 0; i < 3; i++)
+    {
+        printf_ctx_init_buffer(&ctx, out, 64);
+        ctx.cache = cache;
+        munit_assert_int(yaos_format(&ctx, format, -5, (uint64_t)0xabc, "str", 2.5), ==, len);
+        munit_assert_memory_equal(len * sizeof(int), expected, out);
+    }
+    munit_assert_int(cache->misses, ==, 1);
+    munit_assert_int(cache->hits, ==, 2);
+    munit_assert_int(cache->uncached, ==, 0);
+
+    // too many pieces to be cached
+    const char* long_format = "%d %d %d %d %d %d %d %d %d";
+    printf_ctx_init_buffer(&ctx, out, 64);
+    ctx.cache = cache;
+    yaos_format(&ctx, long_format, 1, 2, 3, 4, 5, 6, 7, 8, 9);
+    yaos_format(&ctx, long_format, 1, 2, 3, 4, 5, 6, 7, 8, 9);
+    out[ctx.buffer_index] = 0;
+    check_int_str(out, "1 2 3 4 5 6 7 8 91 2 3 4 5 6 7 8 9");
+    munit_assert_int(cache->misses, ==, 2);
+    munit_assert_int(cache->uncached, ==, 2);
+    free(cache);
+}
+
+/*
+ * Tests replaying recorded log lines gives the same output as formatting them straight away
+*/
+void test_deferred()
+{
+    uint8_t records[256];
+    printf_log log;
+    printf_log_init(&log, records, 256);
+    int expected[BUFFER_LENGTH];
+    int out[BUFFER_LENGTH];
+
+    char str[8] = "task";
+    const char* format = "%s %d %lu %lh %c %f %e \xc3\xa9 %q %%\n";
+    int len = yaos_snprintf(expected, BUFFER_LENGTH, format, str, -7, (uint64_t)1 << 40, (uint64_t)0xdead, 'x', 0.1, 5e-324);
+    munit_assert_int(printf_log_record(&log, format, str, -7, (uint64_t)1 << 40, (uint64_t)0xdead, 'x', 0.1, 5e-324), >, 0);
+    // the string is copied into the record so it can change before the replay
+    str[0] = 'T';
+    len += yaos_snprintf(&(expected[len]), BUFFER_LENGTH - len, "%d %u", INT32_MIN, UINT32_MAX);
+    munit_assert_int(printf_log_record(&log, "%d %u", INT32_MIN, UINT32_MAX), >, 0);
+    // * widths are recorded along with the arguments
+    len += yaos_snprintf(&(expected[len]), BUFFER_LENGTH - len, "[%*s|%-*d|%08.2f]", 6, "ab", -5, 12, 1.5);
+    munit_assert_int(printf_log_record(&log, "[%*s|%-*d|%08.2f]", 6, "ab", -5, 12, 1.5), >, 0);
+    // and so are .* precisions, with only the bytes of a string slice copied
+    const char slice[4] = {'w', 'x', 'y', 'z'};
+    len += yaos_snprintf(&(expected[len]), BUFFER_LENGTH - len, "[%*.*s|%.2s|%.*f]", 4, 3, slice, slice, 1, 2.25);
+    munit_assert_int(printf_log_record(&log, "[%*.*s|%.2s|%.*f]", 4, 3, slice, slice, 1, 2.25), >, 0);
+
+    printf_ctx ctx;
+    printf_ctx_init_buffer(&ctx, out, BUFFER_LENGTH);
+    munit_assert_int(printf_log_replay(records, log.index, &ctx), ==, len);
+    munit_assert_memory_equal(len * sizeof(int), expected, out);
+
+    // records which don't fit are dropped whole
+    int used = log.index;
+    char long_str[256];
+    memset(long_str, 'a', 255);
+    long_str[255] = 0;
+    munit_assert_int(printf_log_record(&log, "%s", long_str), ==, 0);
+    munit_assert_int(log.index, ==, used);
+    munit_assert_int(log.dropped, ==, 1);
+    printf_log_reset(&log);
+    munit_assert_int(log.index, ==, 0);
+}
+
+#define RING_THREADS 4
+#define RING_MESSAGES 2000
+
+printf_ring test_ring_buffer;
+printf_ring_set test_ring_set;
+
+/*
+ * Producer thread for test_ring, printing numbered messages tagged with its thread letter
+*/
+void* ring_producer(void* data)
+{
+    char tag = 'a' + (char)(intptr_t)data;
+    for(int i = 0; i < RING_MESSAGES; i++)
+    {
+        printf_ring_format(&test_ring_buffer, "%c%d\n", tag, i);
+    }
+    return NULL;
+}
+
+/*
+ * Producer thread for test_ring, printing the same messages as ring_producer through a ring of its own
+*/
+void* ring_set_producer(void* data)
+{
+    char tag = 'a' + (char)(intptr_t)data;
+    printf_ring* ring = printf_ring_set_join(&test_ring_set);
+    munit_assert_not_null(ring);
+    for(int i = 0; i < RING_MESSAGES; i++)
+    {
+        printf_ring_format(ring, "%c%d\n", tag, i);
+    }
+    return NULL;
+}
+
+/*
+ * Runs RING_THREADS threads of producer, passing each its thread number, and waits for them to finish
+*/
+void run_ring_threads(void* (*producer)(void*))
+{
+    pthread_t threads[RING_THREADS];
+    for(int i = 0; i < RING_THREADS; i++)
+    {
+        munit_assert_int(pthread_create(&(threads[i]), NULL, producer, (void*)(intptr_t)i), ==, 0);
+    }
+    for(int i = 0; i < RING_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+/*
+ * Checks the len chars in all are whole lines from ring_producer, with each thread's messages in order
+*/
+void check_ring_lines(const int* all, int len)
+{
+    int next[RING_THREADS] = {0};
+    int lines = 0;
+    int pos = 0;
+    while(pos < len)
+    {
+        int tag = all[pos] - 'a';
+        munit_assert_int(tag, >=, 0);
+        munit_assert_int(tag, <, RING_THREADS);
+        pos++;
+        int val = 0;
+        while(all[pos] != '\n')
+        {
+            munit_assert_int(all[pos], >=, '0');
+            munit_assert_int(all[pos], <=, '9');
+            val = val * 10 + all[pos] - '0';
+            pos++;
+        }
+        pos++;
+        munit_assert_int(val, ==, next[tag]);
+        next[tag]++;
+        lines++;
+    }
+    munit_assert_int(lines, ==, RING_THREADS * RING_MESSAGES);
+}
+
+/*
+ * Tests messages from many threads come out of the ring whole and in order for each thread
+*/
+void test_ring()
+{
+    int slots[64];
+    int out[BUFFER_LENGTH];
+    printf_ctx ctx;
+    printf_ctx_init_buffer(&ctx, out, BUFFER_LENGTH);
+    printf_ring_init(&test_ring_buffer, slots, 64, &ctx);
+
+    // the third message needs to skip to the start of the ring but there is no room until it is drained
+    const char* digits = "0123456789abcdef0123456789";
+    munit_assert_int(printf_ring_format(&test_ring_buffer, "%s", digits), ==, 26);
+    munit_assert_int(printf_ring_format(&test_ring_buffer, "%s", digits), ==, 26);
+    munit_assert_int(printf_ring_format(&test_ring_buffer, "%lh", (uint64_t)0xfedcba9876543210ull), ==, -1);
+    munit_assert_int(test_ring_buffer.dropped, ==, 1);
+    munit_assert_int(printf_ring_drain(&test_ring_buffer), ==, 52);
+    munit_assert_int(printf_ring_format(&test_ring_buffer, "%lh", (uint64_t)0xfedcba9876543210ull), ==, 18);
+    munit_assert_int(printf_ring_format(&test_ring_buffer, "\xc3\xa9%d", 12345), ==, 6);
+    munit_assert_int(printf_ring_drain(&test_ring_buffer), ==, 24);
+    out[ctx.buffer_index] = 0;
+    munit_assert_int(out[70], ==, 0xe9);
+    out[70] = 'e';
+    check_int_str(out, "0123456789abcdef01234567890123456789abcdef01234567890xfedcba9876543210e12345");
+
+    // messages are cut short to fit in half the ring
+    printf_ctx_init_buffer(&ctx, out, BUFFER_LENGTH);
+    munit_assert_int(printf_ring_format(&test_ring_buffer, "%s%s", digits, digits), ==, 31);
+    printf_ring_drain(&test_ring_buffer);
+    out[ctx.buffer_index] = 0;
+    check_int_str(out, "0123456789abcdef012345678901234");
+
+    int* all = (int*)malloc(RING_THREADS * RING_MESSAGES * 8 * sizeof(int));
+    printf_ctx_init_buffer(&ctx, all, RING_THREADS * RING_MESSAGES * 8);
+    printf_ring_init(&test_ring_buffer, slots, 64, &ctx);
+    test_ring_buffer.block = 1;
+    munit_assert_int(printf_ring_start(&test_ring_buffer), ==, 0);
+    run_ring_threads(ring_producer);
+    printf_ring_stop(&test_ring_buffer);
+    munit_assert_int(test_ring_buffer.dropped, ==, 0);
+    check_ring_lines(all, ctx.buffer_index);
+
+    // the same with a ring for each thread, and no more threads can join than there are rings
+    int* set_slots = (int*)malloc(RING_THREADS * 64 * sizeof(int));
+    printf_ctx_init_buffer(&ctx, all, RING_THREADS * RING_MESSAGES * 8);
+    printf_ring_set_init(&test_ring_set, set_slots, 64, RING_THREADS, &ctx);
+    test_ring_set.block = 1;
+    munit_assert_int(printf_ring_set_start(&test_ring_set), ==, 0);
+    run_ring_threads(ring_set_producer);
+    printf_ring_set_stop(&test_ring_set);
+    munit_assert_null(printf_ring_set_join(&test_ring_set));
+    check_ring_lines(all, ctx.buffer_index);
+    free(set_slots);
+    free(all);
+}
+
+/*
+ * Reads the len bytes written to the pipe fds and checks they are the same as expected
+*/
+void check_pipe(int* fds, const char* expected, int len)
+{
+    char got[BUFFER_LENGTH];
+    int pos = 0;
+    while(pos < len)
+    {
+        int n = read(fds[0], &(got[pos]), len - pos);
+        munit_assert_int(n, >, 0);
+        pos += n;
+    }
+    munit_assert_memory_equal(len, got, expected);
+}
+
+/*
+ * Tests scatter-gather output gives the same bytes as formatting to a buffer, referencing long strings in
+ * place and still working when the entries or arena run out part way through a message
+*/
+void test_iov()
+{
+    int fds[2];
+    munit_assert_int(pipe(fds), ==, 0);
+    char payload[200];
+    memset(payload, 'p', 199);
+    payload[199] = 0;
+    char expected[BUFFER_LENGTH];
+    struct iovec entries[8];
+    char arena[64];
+    printf_iov iov;
+    printf_iov_init(&iov, fds[1], entries, 8, arena, 64);
+
+    const char* format = "[%5d] %s|%.40s|%-6f|\xc3\xa9%c|%s|a long enough piece of format string text\n";
+    int len = yaos_snprintf_utf8(expected, BUFFER_LENGTH, format, -42, payload, payload, 1.5, 'x', "t\xc3\xa9st\xff");
+    munit_assert_int(printf_iov_format(&iov, format, -42, payload, payload, 1.5, 'x', "t\xc3\xa9st\xff"), ==, len - 2);
+    munit_assert_int(iov.writes, ==, 1);
+    check_pipe(fds, expected, len);
+
+    // a value which doesn't fit in the arena is written in pieces, and the message is still whole
+    printf_iov_init(&iov, fds[1], entries, 2, arena, 8);
+    len = yaos_snprintf_utf8(expected, BUFFER_LENGTH, "%s %.30f %d%d%d", payload, 0.1, 1, 2, 3);
+    munit_assert_int(printf_iov_format(&iov, "%s %.30f %d%d%d", payload, 0.1, 1, 2, 3), ==, len);
+    munit_assert_int(iov.writes, >, 1);
+    check_pipe(fds, expected, len);
+
+    close(fds[0]);
+    close(fds[1]);
+    munit_assert_int(printf_iov_format(&iov, "%d", 1), ==, -1);
+    munit_assert_int(iov.error, ==, EBADF);
+}
+
+/*
+ * Tests formatting from tagged argument arrays gives the same output as from a va_list, and that arguments of
+ * the wrong type print '?'
+*/
+void test_args()
+{
+    int expected[BUFFER_LENGTH];
+    int out[BUFFER_LENGTH];
+    printf_ctx ctx;
+    printf_ctx_init_buffer(&ctx, out, BUFFER_LENGTH);
+    const char* format = "%d %ld %u %lh %f %.2e %s %c|%*d|%.*s|\xc3\xa9%%";
+    printf_arg args[] = {PRINTF_INT32(-7), PRINTF_INT64(-((int64_t)1 << 40)), PRINTF_UINT32(7),
+        PRINTF_UINT64(0xdeadbeefcafeull), PRINTF_DOUBLE(0.1), PRINTF_DOUBLE(1234.5), PRINTF_STRING("str"),
+        PRINTF_INT32('x'), PRINTF_INT32(-4), PRINTF_INT32(3), PRINTF_UINT32(2), PRINTF_STRING("abc")};
+    int len = yaos_snprintf(expected, BUFFER_LENGTH, format, -7, -((int64_t)1 << 40), 7u, 0xdeadbeefcafeull, 0.1,
+        1234.5, "str", 'x', -4, 3, 2, "abc");
+    munit_assert_int(printf_args_format(&ctx, format, args, 12), ==, len);
+    munit_assert_memory_equal(len * sizeof(int), expected, out);
+
+    // wrong types (a 64 bit int for %d, an int for %f, a NULL string) and missing arguments print '?'
+    ctx.buffer_index = 0;
+    printf_arg wrong[] = {PRINTF_INT64(1), PRINTF_INT32(2), PRINTF_STRING(NULL), PRINTF_UINT32(5)};
+    munit_assert_int(printf_args_format(&ctx, "%d %f %s %u %d", wrong, 4), ==, 9);
+    out[9] = 0;
+    check_int_str(out, "? ? ? 5 ?");
+
+    // a batch parses the format once for all its records
+    ctx.buffer_index = 0;
+    printf_arg records[] = {PRINTF_STRING("cpu"), PRINTF_DOUBLE(0.5), PRINTF_STRING("mem"), PRINTF_DOUBLE(12.25),
+        PRINTF_STRING("io"), PRINTF_DOUBLE(-3.0)};
+    const char* batch_expected = "cpu=0.50\nmem=12.25\nio=-3.00\n";
+    munit_assert_int(printf_args_format_batch(&ctx, "%s=%.2f\n", records, 2, 3), ==, (int)strlen(batch_expected));
+    out[ctx.buffer_index] = 0;
+    check_int_str(out, batch_expected);
+}
+
+/*
+ * Internal function
+ * Streams a message in chunks of every size from 1 to 70 bytes, checking the chunks join up to the same bytes as
+ * yaos_snprintf_utf8 prints and that each chunk but the last is full
+*/
+void _check_stream(const char* format, ...)
+{
+    static char expected[0x10000];
+    static char out[0x10000];
+    char chunk[70];
+    va_list args;
+    va_start(args, format);
+    int len = yaos_vsnprintf_utf8(expected, sizeof(expected), format, args);
+    va_end(args);
+    for(int size = 1; size <= 70; size++)
+    {
+        va_start(args, format);
+        printf_stream stream;
+        printf_stream_init(&stream, format, args);
+        int total = 0;
+        int more = 1;
+        while(more)
+        {
+            int n;
+            more = printf_stream_next(&stream, chunk, size, &n);
+            munit_assert_true(n == size || !more);
+            munit_assert_int(total + n, <=, len);
+            memcpy(&(out[total]), chunk, n);
+            total += n;
+        }
+        printf_stream_end(&stream);
+        va_end(args);
+        munit_assert_int(total, ==, len);
+        munit_assert_memory_equal(len, expected, out);
+    }
+}
+
+/*
+ * Tests streaming messages in fixed size chunks, with chunks ending part way into text, padding, numbers and long
+ * floats
+*/
+void test_stream()
+{
+    _check_stream("");
+    _check_stream("plain text \xe2\x82\xac with no fields %%");
+    _check_stream("%d|%-8u|%08h|%c|%5s|%-5s|%.3s|%*d|%.*s|%.2d", -123456789, 42u, 0xbeefu, 'z', "ab", "cd",
+        "abcdef", -6, 77, 2, "xyz", 5);
+    _check_stream("tiny %f and long %.40f then %e", 8e-310, 1.0 / 3.0, 6.02214076e23);
+    _check_stream("%s \xff bad \xc3 bytes %s", "a long string argument streamed straight from where it is \xc3\xa9",
+        "\xe2\x82");
+    _check_stream("%lu %ld %lh %lb", UINT64_MAX, INT64_MIN, UINT64_MAX, 5ull);
+    // padded strings, and fields far longer than a chunk which are printed once and carried on from
+    _check_stream("%8s|%-9.4s|%*s|%3s|%-*c|", "\xc3\xa9t\xc3\xa9", "ab\xffz", 6, "x", "too long", 4, 'c');
+    _check_stream("%.1074f|%-1100.1074e|%.30000f", 4.9e-324, -4.9e-324, 1.0 / 3.0);
+}
+
+/*
+ * Tests asynchronous output keeps messages whole and in order through the flusher, hands over a quiet buffer
+ * after flush_ms, and drops the newest or oldest messages when every buffer is full
+*/
+void test_async()
+{
+    int fds[2];
+    munit_assert_int(pipe(fds), ==, 0);
+    char memory[4 * 64];
+    char expected[BUFFER_LENGTH];
+    printf_async async;
+
+    // with no flusher running the buffers fill up, then the flush writes them in order
+    const int policies[2] = {PRINTF_ASYNC_DROP_NEWEST, PRINTF_ASYNC_DROP_OLDEST};
+    const char* kept[2] = {"msg 0 0.00|msg 1 0.50|", "msg 1 0.50|msg 2 1.00|"};
+    for(int p = 0; p < 2; p++)
+    {
+        printf_async_init(&async, fds[1], memory, 2, 16);
+        async.policy = policies[p];
+        munit_assert_int(printf_async_format(&async, "msg %d %.2f|", 0, 0.0), ==, 11);
+        munit_assert_int(printf_async_format(&async, "msg %d %.2f|", 1, 0.5), ==, 11);
+        munit_assert_int(printf_async_format(&async, "msg %d %.2f|", 2, 1.0), ==, p == 0 ? -1 : 11);
+        munit_assert_int(async.dropped, ==, 1);
+        munit_assert_int(printf_async_flush(&async), ==, 0);
+        check_pipe(fds, kept[p], 22);
+        printf_async_destroy(&async);
+    }
+
+    // blocking with the flusher running keeps every message, handing a buffer over at each newline
+    printf_async_init(&async, fds[1], memory, 4, 64);
+    async.flush_newline = 1;
+    munit_assert_int(printf_async_start(&async), ==, 0);
+    int len = 0;
+    for(int i = 0; i < 40; i++)
+    {
+        len += yaos_snprintf_utf8(&(expected[len]), BUFFER_LENGTH - len, "line %d \xc3\xa9 %.3f\n", i, i / 8.0);
+        printf_async_format(&async, "line %d \xc3\xa9 %.3f\n", i, i / 8.0);
+    }
+    munit_assert_int(printf_async_flush(&async), ==, 0);
+    check_pipe(fds, expected, len);
+    munit_assert_int(async.dropped, ==, 0);
+    printf_async_stop(&async);
+    printf_async_destroy(&async);
+
+    // a message with no newline is handed over once the flusher has waited flush_ms for more
+    printf_async_init(&async, fds[1], memory, 2, 64);
+    async.flush_ms = 1;
+    munit_assert_int(printf_async_start(&async), ==, 0);
+    printf_async_format(&async, "no newline %d", 5);
+    check_pipe(fds, "no newline 5", 12);
+    printf_async_destroy(&async);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/*
+ * Tests the statistics gathered for a context: calls and chars per conversion, truncated output, invalid UTF-8
+ * and the latency histogram
+*/
+void test_stats()
+{
+    printf_stats stats;
+    printf_stats_init(&stats);
+    int out[8];
+    printf_ctx ctx;
+    printf_ctx_init_buffer(&ctx, out, 8);
+    ctx.stats = &stats;
+    // "1234 ab??" is 9 chars, one more than the buffer holds
+    munit_assert_int(yaos_format(&ctx, "%d %s\xff", 1234, "ab\xfe"), ==, 9);
+    munit_assert_int(stats.calls, ==, 1);
+    munit_assert_int(stats.chars, ==, 9);
+    munit_assert_int(stats.truncated, ==, 1);
+    munit_assert_int(stats.invalid_utf8, ==, 2);
+    munit_assert_int(printf_stats_conv_calls(&stats, 'd'), ==, 1);
+    munit_assert_int(printf_stats_conv_chars(&stats, 'd'), ==, 4);
+    munit_assert_int(printf_stats_conv_chars(&stats, 's'), ==, 3);
+    munit_assert_int(printf_stats_conv_calls(&stats, 'f'), ==, 0);
+
+    // cached format strings are counted the same, including their invalid bytes
+    char text[BUFFER_LENGTH];
+    printf_cache cache;
+    printf_cache_init(&cache);
+    printf_ctx utf8_ctx;
+    printf_ctx_init_utf8_buffer(&utf8_ctx, text, BUFFER_LENGTH);
+    utf8_ctx.cache = &cache;
+    utf8_ctx.stats = &stats;
+    for(int i = 0; i < 3; i++)
+    {
+        munit_assert_int(yaos_format(&utf8_ctx, "%5.2f|%c\xff", 1.5, 'x'), ==, 8);
+    }
+    munit_assert_int(stats.calls, ==, 4);
+    munit_assert_int(stats.invalid_utf8, ==, 5);
+    munit_assert_int(printf_stats_conv_calls(&stats, 'f'), ==, 3);
+    munit_assert_int(printf_stats_conv_chars(&stats, 'f'), ==, 15);
+    munit_assert_int(printf_stats_conv_calls(&stats, 'c'), ==, 3);
+    munit_assert_int(stats.truncated, ==, 1);
+
+    uint64_t counted = 0;
+    for(int i = 0; i < PRINTF_STATS_BUCKETS; i++)
+    {
+        counted += stats.latency[i];
+    }
+    munit_assert_int(counted, ==, 4);
+    munit_assert_int(printf_stats_latency(&stats, 50), <=, printf_stats_latency(&stats, 100));
+    munit_assert_int(printf_stats_latency(&stats, 100), >, 0);
+
+    // the report is printed with the formatter itself, so isn't counted in stats it reads
+    printf_ctx_init_utf8_buffer(&utf8_ctx, text, BUFFER_LENGTH);
+    printf_stats_print(&utf8_ctx, &stats);
+    text[utf8_ctx.buffer_index] = 0;
+    munit_assert_memory_equal(64, text, "calls 4 chars 33 truncated 1 invalid utf-8 5\n%s calls 1 chars 3\n");
+
+    // a string with a width and a precision is one conversion, counted once
+    printf_stats_init(&stats);
+    printf_ctx_init_utf8_buffer(&utf8_ctx, text, BUFFER_LENGTH);
+    utf8_ctx.stats = &stats;
+    munit_assert_int(yaos_format(&utf8_ctx, "%8.3s|%-4.2s", "abcdef", "xyz"), ==, 13);
+    munit_assert_memory_equal(13, text, "     abc|xy  ");
+    munit_assert_int(printf_stats_conv_calls(&stats, 's'), ==, 2);
+    munit_assert_int(printf_stats_conv_chars(&stats, 's'), ==, 12);
+}
+
+/*
+ * Tests measuring gives the length formatting would, and that asprintf allocates exactly that from an arena
+*/
+void test_measure()
+{
+    // digit counts at each power of 10, floats with carries and strings with invalid bytes
+    // (and chars past ascii, which are 2 bytes where char is unsigned)
+    const char* format = "%d|%lu|%lh|%lb|%8lo|%f|%e|%.1f|%.2e|%-12s|%*s|%.3s|%c\xc3\xa9\xff%%|%5c|%c";
+    uint64_t val = 1;
+    for(int i = 0; i < 20; i++, val *= 10)
+    {
+        const double floats[3] = {val - 0.5, 9.96, 1e300 / val};
+        for(int j = 0; j < 3; j++)
+        {
+            int len = yaos_snprintf_utf8(NULL, 0, format, (int)val - 1, val, val - 1, val, val, floats[j], -floats[j],
+                floats[j], floats[j] * 9.999, "t\xc3\xa9st", i, "\xc0\x80\xff", "\xe2\x82\xac", 'x', '\xe9', '\xe9');
+            munit_assert_int(yaos_measure(format, (int)val - 1, val, val - 1, val, val, floats[j], -floats[j],
+                floats[j], floats[j] * 9.999, "t\xc3\xa9st", i, "\xc0\x80\xff", "\xe2\x82\xac", 'x', '\xe9', '\xe9'), ==,
+                len);
+        }
+    }
+
+    char memory[64];
+    printf_arena arena;
+    printf_arena_init(&arena, memory, sizeof(memory));
+    printf_allocator allocator = printf_arena_allocator(&arena);
+    char* str;
+    munit_assert_int(yaos_asprintf(&allocator, &str, "%s=%.2f %c", "temp", 21.125, '!'), ==, 12);
+    munit_assert_string_equal(str, "temp=21.12 !");
+    munit_assert_int(arena.used, ==, 13);
+    munit_assert_int(yaos_asprintf(&allocator, &str, "%40d|", 7), ==, 41);
+    munit_assert_ptr_equal(str, &(memory[13]));
+    munit_assert_int(arena.used, ==, 55);
+    // no room left in the arena
+    munit_assert_int(yaos_asprintf(&allocator, &str, "%10d", 7), ==, -1);
+    munit_assert_null(str);
+    printf_arena_reset(&arena);
+    munit_assert_int(yaos_asprintf(&allocator, &str, "%10d", 7), ==, 10);
+
+    // with no allocator the string comes from malloc
+    munit_assert_int(yaos_asprintf(NULL, &str, "%s \xe2\x82\xac%u", "cost", 5u), ==, 9);
+    munit_assert_string_equal(str, "cost \xe2\x82\xac" "5");
+    free(str);
+
+    // invalid UTF-8 in the format string is measured as the '?' written for each byte, and the length returned
+    // is always what was written
+    const char* invalid = "a\xed\xa0\x80z\xc0\xafq\xf7\xbf\xbf\xbf";
+    munit_assert_int(yaos_measure(invalid), ==, 12);
+    munit_assert_int(yaos_asprintf(NULL, &str, invalid), ==, 12);
+    munit_assert_string_equal(str, "a???z??q????");
+    free(str);
+    int len = yaos_asprintf(NULL, &str, "%5c|%c", '\xe9', '\xe9');
+    munit_assert_int(len, ==, (int)strlen(str));
+    munit_assert_int(len, ==, yaos_snprintf_utf8(NULL, 0, "%5c|%c", '\xe9', '\xe9'));
+    free(str);
+}
+
+// C++ front end tests (run_cpp.cpp)
+void test_cpp();
+
 void run_tests()
 {
     printf("Testing float special case\n");
@@ -296,6 +1442,50 @@ void run_tests()
     test_double_general();
     printf("Testing double subnormal\n");
     test_double_subnormal();
+    printf("Testing significant figures\n");
+    test_sig_figs();
+    printf("Testing float precision\n");
+    test_float_precision();
+    printf("Testing width and alignment\n");
+    test_width();
+    printf("Testing string slices\n");
+    test_string_slices();
+    printf("Testing UTF-8 output\n");
+    test_utf8();
+    printf("Testing to_chars\n");
+    test_to_chars();
+    printf("Testing float engines agree\n");
+    test_float_engines();
+    printf("Testing 32 bit float path\n");
+    test_float32();
+    printf("Testing snprintf\n");
+    test_snprintf();
+    printf("Testing int\n");
+    test_int();
+    printf("Testing binary, octal and hex\n");
+    test_pow2();
+    printf("Testing literal text\n");
+    test_literal();
+    printf("Testing compiled format strings\n");
+    test_compiled();
+    printf("Testing deferred logging\n");
+    test_deferred();
+    printf("Testing ring buffer\n");
+    test_ring();
+    printf("Testing scatter-gather output\n");
+    test_iov();
+    printf("Testing tagged arguments\n");
+    test_args();
+    printf("Testing streaming in chunks\n");
+    test_stream();
+    printf("Testing asynchronous output\n");
+    test_async();
+    printf("Testing statistics\n");
+    test_stats();
+    printf("Testing measuring and asprintf\n");
+    test_measure();
+    printf("Testing C++ front end\n");
+    test_cpp();
 }
 #endif
 
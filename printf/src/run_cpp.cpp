@@ -0,0 +1,108 @@
+// License: GPL-2.0
+// Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+//
+// Unless required by applicable law or agreed to in writing, this software
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.
+
+#include <printf.hpp>
+#include <munit.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#define CPP_BUFFER_LENGTH 0x400
+
+/*
+ * Checks yaos::print with format string F gives the same output as the C formatter given the same arguments
+*/
+template<yaos::format_string F, typename... Args>
+void check_print(const Args&... args)
+{
+    int expected[CPP_BUFFER_LENGTH];
+    int out[CPP_BUFFER_LENGTH];
+    int len = yaos_snprintf(expected, CPP_BUFFER_LENGTH, F.str, args...);
+    printf_ctx ctx;
+    printf_ctx_init_buffer(&ctx, out, CPP_BUFFER_LENGTH);
+    munit_assert_int(yaos::print<F>(&ctx, args...), ==, len);
+    munit_assert_int(ctx.buffer_index, ==, len);
+    munit_assert_memory_equal(len * sizeof(int), expected, out);
+}
+
+/*
+ * Decodes the utf-8 char at str at compile time and returns its byte count, or 0 if it is invalid
+*/
+constexpr int decoded_bytes(const char* str)
+{
+    int code = 0;
+    return yaos::detail::decode_char(str, code);
+}
+
+// the compile time decoder is as strict as the C one: overlong forms, surrogates and codes above 0x10ffff are invalid
+static_assert(decoded_bytes("\xc0\xaf") == 0, "overlong forms are invalid");
+static_assert(decoded_bytes("\xe0\x80\xaf") == 0, "overlong forms are invalid");
+static_assert(decoded_bytes("\xed\xa0\x80") == 0, "surrogates are invalid");
+static_assert(decoded_bytes("\xf4\x90\x80\x80") == 0, "codes above 0x10ffff are invalid");
+static_assert(decoded_bytes("\xed\x9f\xbf") == 3 && decoded_bytes("\xf4\x8f\xbf\xbf") == 4, "the last chars in range are valid");
+
+/*
+ * Tests the C++ front end against the C formatter
+*/
+extern "C" void test_cpp()
+{
+    check_print<"plain text">();
+    check_print<"%d %ld %u %lu">(-5, (int64_t)-1 << 40, 7u, (uint64_t)1 << 63);
+    check_print<"%h %lh %o %lo %b %lb">(0xbeefu, (uint64_t)0xdeadbeefcafe, 8u, (uint64_t)9, 5u, (uint64_t)6);
+    check_print<"%f|%e|%f|%e">(23.789, 0.001, 8e-310, -1.5e300);
+    check_print<"%.3f|%.0e|%.f|%.20e|%.2d %.1c">(23.7895, 0.001, 2.5, 8e-310);
+    check_print<"%s %c%c">("str \xc3\xa9", 'a', 'b');
+    check_print<"100%% \xe2\x82\xac %q %lq %ls %lf \xff">();
+    check_print<"%d%">(1);
+    check_print<"a\xc0\xafz\xed\xa0\x80q\xf4\x90\x80\x80">();
+    // smaller types are widened
+    check_print<"%d %u">((int16_t)-3, (uint8_t)200);
+    check_print<"%5d|%-5d|%05d|%08h|%-8s|%3c|%010.3f|%-9e">(42, 42, -42, 0xbeu, "ab", 'x', -1.5, 1e-10);
+    check_print<"%*d|%-*u|%*s|%5%|%-q">(6, -7, 4, 3u, -5, "\xc3\xa9t\xc3\xa9");
+    check_print<"%.3s|%.*s|%*.*s|%.*f|%.*e">("hello", 2, "hello", 6, 1, "\xc3\xa9t\xc3\xa9", 3, 1.5, -1, 2.5);
+
+    int out[CPP_BUFFER_LENGTH];
+    printf_ctx ctx;
+    // string views print with their length, with no NUL needed after them
+    printf_ctx_init_buffer(&ctx, out, CPP_BUFFER_LENGTH);
+    std::string_view view = std::string_view("slice of text").substr(0, 5);
+    munit_assert_int(yaos::print<"%s|%.3s|%-7s|%*.*s|%s">(&ctx, view, view, view, 4, 2, view, std::string("str")), ==, 26);
+    const char* view_expected = "slice|sli|slice  |  sl|str";
+    for(int i = 0; i < 26; i++)
+    {
+        munit_assert_int(out[i], ==, view_expected[i]);
+    }
+
+    // floats without a precision use the 32 bit path rather than being widened
+    printf_ctx_init_buffer(&ctx, out, CPP_BUFFER_LENGTH);
+    ctx.sig_figs = PRINTF_SHORTEST;
+    munit_assert_int(yaos::print<"%f %e %.2f">(&ctx, 0.1f, 2.34185f, 0.125f), ==, 18);
+    const char* expected = "0.1 2.34185e0 0.12";
+    for(int i = 0; i < 18; i++)
+    {
+        munit_assert_int(out[i], ==, expected[i]);
+    }
+    // and keep their digits with a width
+    printf_ctx_init_buffer(&ctx, out, CPP_BUFFER_LENGTH);
+    ctx.sig_figs = PRINTF_SHORTEST;
+    munit_assert_int(yaos::print<"%-6f|%06f">(&ctx, 0.1f, -0.1f), ==, 13);
+    expected = "0.1   |-000.1";
+    for(int i = 0; i < 13; i++)
+    {
+        munit_assert_int(out[i], ==, expected[i]);
+    }
+    // and round from the exact value when cut to PRINTF_SIG_FIGS
+    printf_ctx_init_buffer(&ctx, out, CPP_BUFFER_LENGTH);
+    munit_assert_int(yaos::print<"%f %e">(&ctx, 2.34185f, 2.34185f), ==, 15);
+    expected = "2.3419 2.3419e0";
+    for(int i = 0; i < 15; i++)
+    {
+        munit_assert_int(out[i], ==, expected[i]);
+    }
+}
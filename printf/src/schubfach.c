@@ -0,0 +1,197 @@
+// License GPL-2.0
+// Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+//
+// Unless required by applicable law or agreed to in writing, this software
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.
+
+/*
+ * Schubfach, following the reference implementation of the paper in OpenJDK's DoubleToDecimal
+ * A double is v = c * 2 ^ q. Schubfach finds k so that 10 ^ -k scales v to 17 or 18 digits, takes the scaled
+ * value and the bounds of the rounding interval with a round to odd multiply, then picks the digits either one
+ * digit shorter (if exactly one candidate is in the interval) or of the full length (the closest)
+*/
+
+#include <schubfach.h>
+
+#include <stdint.h>
+
+#include "schubfach_table.h"
+
+#define SCHUBFACH_MANTISSA_BITS 52
+#define SCHUBFACH_EXP_MASK 0x7ff
+// exponent q of the smallest subnormal
+#define SCHUBFACH_Q_MIN -1074
+// c of the smallest normal double, which has a narrower interval below it
+#define SCHUBFACH_C_MIN (1ull << SCHUBFACH_MANTISSA_BITS)
+// subnormals with c below this are scaled by 10 so enough digits are computed
+#define SCHUBFACH_C_TINY 3
+#define SCHUBFACH_MASK_63 0x7fffffffffffffffull
+
+/*
+ * Internal function
+ * floor(log10(2 ^ e))
+*/
+int _schubfach_flog10_pow2(int e)
+{
+    return (int)(((int64_t)e * 661971961083ll) >> 41);
+}
+
+/*
+ * Internal function
+ * floor(log10(3 / 4 * 2 ^ e))
+*/
+int _schubfach_flog10_three_quarters_pow2(int e)
+{
+    return (int)(((int64_t)e * 661971961083ll - 274743187321ll) >> 41);
+}
+
+/*
+ * Internal function
+ * floor(log2(10 ^ e))
+*/
+int _schubfach_flog2_pow10(int e)
+{
+    return (int)(((int64_t)e * 913124641741ll) >> 38);
+}
+
+/*
+ * Internal function
+ * Returns the top 64 bits of the 128 bit product of a and b
+*/
+uint64_t _schubfach_mul_high(uint64_t a, uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+    return (uint64_t)(((unsigned __int128)a * b) >> 64);
+#else
+    uint64_t a_lo = (uint32_t)a;
+    uint64_t a_hi = a >> 32;
+    uint64_t b_lo = (uint32_t)b;
+    uint64_t b_hi = b >> 32;
+    uint64_t lo_lo = a_lo * b_lo;
+    uint64_t hi_lo = a_hi * b_lo;
+    uint64_t lo_hi = a_lo * b_hi;
+    uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + lo_hi;
+    return a_hi * b_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+/*
+ * Internal function
+ * Returns cp * g / 2 ^ 127 rounded to odd, where g = g1 * 2 ^ 63 + g0
+ * The lowest bit is set if any bits were dropped so comparisons with the exact value can't be fooled by rounding
+*/
+uint64_t _schubfach_round_odd(uint64_t g1, uint64_t g0, uint64_t cp)
+{
+    uint64_t x1 = _schubfach_mul_high(g0, cp);
+    uint64_t y0 = g1 * cp;
+    uint64_t y1 = _schubfach_mul_high(g1, cp);
+    uint64_t z = (y0 >> 1) + x1;
+    uint64_t vbp = y1 + (z >> 63);
+    return vbp | (((z & SCHUBFACH_MASK_63) + SCHUBFACH_MASK_63) >> 63);
+}
+
+/*
+ * Internal function
+ * Returns f * 10 ^ e with the trailing zeros of f moved into the exponent
+*/
+floating_decimal_64 _schubfach_result(uint64_t f, int e)
+{
+    floating_decimal_64 dec;
+    while(f % 10 == 0)
+    {
+        f /= 10;
+        e++;
+    }
+    dec.mantissa = f;
+    dec.exponent = e;
+    return dec;
+}
+
+/*
+ * Internal function
+ * Returns the shortest decimal for v = c * 2 ^ q, with the result scaled by 10 ^ dk to undo c having been scaled
+*/
+floating_decimal_64 _schubfach_to_decimal(int q, uint64_t c, int dk)
+{
+    uint64_t out = c & 1;
+    uint64_t cb = c << 2;
+    uint64_t cbr = cb + 2;
+    uint64_t cbl;
+    int k;
+    if(c != SCHUBFACH_C_MIN || q == SCHUBFACH_Q_MIN)
+    {
+        cbl = cb - 2;
+        k = _schubfach_flog10_pow2(q);
+    }
+    else
+    {
+        // the interval below a power of 2 is half as wide
+        cbl = cb - 1;
+        k = _schubfach_flog10_three_quarters_pow2(q);
+    }
+    int h = q + _schubfach_flog2_pow10(-k) + 2;
+    const uint64_t* g = SCHUBFACH_G[k - SCHUBFACH_K_MIN];
+    uint64_t vb = _schubfach_round_odd(g[0], g[1], cb << h);
+    uint64_t vbl = _schubfach_round_odd(g[0], g[1], cbl << h);
+    uint64_t vbr = _schubfach_round_odd(g[0], g[1], cbr << h);
+
+    uint64_t s = vb >> 2;
+    // (the reference stops at 100 as Java always prints 2 digits, so would give 4.9e-324 rather than 5e-324)
+    if(s >= 10)
+    {
+        // one digit shorter: the multiples of 10 either side of s
+        uint64_t sp10 = 10 * _schubfach_mul_high(s, 115292150460684698ull << 4);
+        uint64_t tp10 = sp10 + 10;
+        int upin = vbl + out <= sp10 << 2;
+        int wpin = (tp10 << 2) + out <= vbr;
+        if(upin != wpin)
+        {
+            return _schubfach_result(upin ? sp10 : tp10, k + dk);
+        }
+        if(upin)
+        {
+            // both only fit for the smallest subnormals, which are scaled by 10, so take the closest
+            int64_t cmp = (int64_t)(vb - ((sp10 + tp10) << 1));
+            return _schubfach_result(cmp < 0 || (cmp == 0 && ((sp10 / 10) & 1) == 0) ? sp10 : tp10, k + dk);
+        }
+    }
+    // full length: s or s + 1, whichever is in the interval or else the closest (ties to even)
+    uint64_t t = s + 1;
+    int uin = vbl + out <= s << 2;
+    int win = (t << 2) + out <= vbr;
+    if(uin != win)
+    {
+        return _schubfach_result(uin ? s : t, k + dk);
+    }
+    int64_t cmp = (int64_t)(vb - ((s + t) << 1));
+    return _schubfach_result(cmp < 0 || (cmp == 0 && (s & 1) == 0) ? s : t, k + dk);
+}
+
+/*
+ * Converts the mantissa and exponent bits of a finite, non zero double to its shortest round trip decimal
+ * (see schubfach.h)
+*/
+floating_decimal_64 schubfach_d2d(uint64_t ieee_mantissa, uint32_t ieee_exponent)
+{
+    if(ieee_exponent != 0)
+    {
+        int mq = -SCHUBFACH_Q_MIN + 1 - (int)ieee_exponent;
+        uint64_t c = SCHUBFACH_C_MIN | ieee_mantissa;
+        // integers below 2 ^ 53 are their own shortest digits
+        if(mq > 0 && mq <= SCHUBFACH_MANTISSA_BITS)
+        {
+            uint64_t f = c >> mq;
+            if(f << mq == c)
+            {
+                return _schubfach_result(f, 0);
+            }
+        }
+        return _schubfach_to_decimal(-mq, c, 0);
+    }
+    if(ieee_mantissa < SCHUBFACH_C_TINY)
+    {
+        return _schubfach_to_decimal(SCHUBFACH_Q_MIN, 10 * ieee_mantissa, -1);
+    }
+    return _schubfach_to_decimal(SCHUBFACH_Q_MIN, ieee_mantissa, 0);
+}
@@ -0,0 +1,320 @@
+// License GPL-2.0
+// Please see https://www.gnu.org/licenses/old-licenses/gpl-2.0.html#SEC1
+//
+// Unless required by applicable law or agreed to in writing, this software
+// is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.
+
+#include <stream.h>
+
+#include <stdarg.h>
+#include <string.h>
+
+/*
+ * Internal function
+ * Adds a run of len bytes of chars (fill == 0) or of len copies of fill to the field being recorded in stream,
+ * joining it to the last run if that is the same kind
+*/
+void _record_run(printf_stream* stream, char fill, int len)
+{
+    if(stream->num_runs > 0 && stream->runs[stream->num_runs - 1].fill == fill)
+    {
+        stream->runs[stream->num_runs - 1].len += len;
+    }
+    else if(stream->num_runs < PRINTF_STREAM_RUNS)
+    {
+        stream->runs[stream->num_runs].len = len;
+        stream->runs[stream->num_runs].fill = fill;
+        stream->num_runs++;
+    }
+}
+
+/*
+ * Sink functions recording a field into the runs of a printf_stream
+ * chars_pos counts the chars recorded so far
+*/
+void _record_put_chars(void* data, const char* str, int len)
+{
+    printf_stream* stream = data;
+    int room = PRINTF_STREAM_FIELD_CHARS - stream->chars_pos;
+    len = len < room ? len : room;
+    memcpy(&(stream->chars[stream->chars_pos]), str, len);
+    stream->chars_pos += len;
+    _record_run(stream, 0, len);
+}
+
+void _record_put_code(void* data, int code)
+{
+    char bytes[4];
+    int len = encode_char(code, bytes);
+    if(len == 0)
+    {
+        bytes[0] = '?';
+        len = 1;
+    }
+    _record_put_chars(data, bytes, len);
+}
+
+void _record_put_fill(void* data, char c, int count)
+{
+    _record_run(data, c, count);
+}
+
+/*
+ * Internal function
+ * Streams up to room bytes of the text being streamed to out, checking it is valid UTF-8 a run at a time and
+ * putting '?' in place of invalid bytes
+ * Returns the number of bytes written
+*/
+int _stream_text(printf_stream* stream, char* out, int room)
+{
+    int n = 0;
+    while(n < room && stream->text_len > 0)
+    {
+        if(stream->valid == 0)
+        {
+            int chars;
+            stream->valid = valid_utf8_length(stream->text, stream->text_len, &chars);
+            if(stream->valid == 0)
+            {
+                out[n] = '?';
+                n++;
+                stream->text++;
+                stream->text_len--;
+                continue;
+            }
+        }
+        int len = stream->valid < room - n ? stream->valid : room - n;
+        memcpy(&(out[n]), stream->text, len);
+        n += len;
+        stream->text += len;
+        stream->text_len -= len;
+        stream->valid -= len;
+    }
+    return n;
+}
+
+/*
+ * Internal function
+ * Streams up to room of the pad spaces left to out, taking them off pad
+ * Returns the number of bytes written
+*/
+int _stream_pad(int* pad, char* out, int room)
+{
+    int n = *pad < room ? *pad : room;
+    memset(out, ' ', n);
+    *pad -= n;
+    return n;
+}
+
+/*
+ * Internal function
+ * Streams up to room bytes of the field being streamed to out, carrying on from the run and byte the last call
+ * stopped at
+ * Returns the number of bytes written
+*/
+int _stream_field(printf_stream* stream, char* out, int room)
+{
+    int n = 0;
+    while(n < room && stream->run < stream->num_runs)
+    {
+        const printf_stream_run* run = &(stream->runs[stream->run]);
+        int len = run->len - stream->run_pos < room - n ? run->len - stream->run_pos : room - n;
+        if(run->fill != 0)
+        {
+            memset(&(out[n]), run->fill, len);
+        }
+        else
+        {
+            memcpy(&(out[n]), &(stream->chars[stream->chars_pos]), len);
+            stream->chars_pos += len;
+        }
+        n += len;
+        stream->run_pos += len;
+        if(stream->run_pos == run->len)
+        {
+            stream->run++;
+            stream->run_pos = 0;
+        }
+    }
+    return n;
+}
+
+/*
+ * Internal function
+ * Prints value with the format specifier spec into the runs of stream, to be streamed from the start
+*/
+void _record_field(printf_stream* stream, const printf_spec* spec, printf_value value)
+{
+    const printf_sink sink = {
+        .put_chars = _record_put_chars,
+        .put_code = _record_put_code,
+        .put_fill = _record_put_fill,
+        .put_ref = NULL,
+        .data = stream
+    };
+    printf_ctx ctx;
+    printf_ctx_init_sink(&ctx, &sink);
+    ctx.utf8 = 1;
+    ctx.sig_figs = stream->sig_figs;
+    stream->num_runs = 0;
+    stream->chars_pos = 0;
+    yaos_format_value(&ctx, spec, value);
+    stream->run = 0;
+    stream->run_pos = 0;
+    stream->chars_pos = 0;
+}
+
+/*
+ * Internal function
+ * Returns the number of chars the len bytes of str print as, an invalid byte printing as a single '?'
+*/
+int _stream_text_chars(const char* str, int len)
+{
+    int n = 0;
+    while(len > 0)
+    {
+        int chars;
+        int valid = valid_utf8_length(str, len, &chars);
+        n += chars;
+        str += valid;
+        len -= valid;
+        if(len > 0)
+        {
+            n++;
+            str++;
+            len--;
+        }
+    }
+    return n;
+}
+
+/*
+ * Internal function
+ * Sets up the next piece of the format string to stream, as text or as a field, taking its arguments
+*/
+void _stream_piece(printf_stream* stream)
+{
+    stream->valid = 0;
+    if(*(stream->str) != '%')
+    {
+        stream->text = stream->str;
+        stream->text_len = strcspn(stream->str, "%");
+        stream->str += stream->text_len;
+        return;
+    }
+    printf_op op;
+    stream->str += yaos_parse_op(stream->str, &op);
+    if(op.type != PRINTF_OP_CONV)
+    {
+        // %% and invalid specifiers
+        stream->text = op.str;
+        stream->text_len = op.len;
+        return;
+    }
+    printf_spec spec = op.spec;
+    if(op.spec.width == PRINTF_WIDTH_ARG)
+    {
+        yaos_set_width(&spec, va_arg(stream->args, int));
+    }
+    if(op.spec.prec == PRINTF_PREC_ARG)
+    {
+        yaos_set_prec(&spec, va_arg(stream->args, int));
+    }
+    printf_value value = yaos_read_arg(&spec, &(stream->args));
+    if(spec.conv != 's')
+    {
+        _record_field(stream, &spec, value);
+        return;
+    }
+    // strings are streamed straight from the argument, with their padding counted from their chars
+    stream->text = value.s;
+    if(spec.prec >= 0)
+    {
+        const char* nul = memchr(value.s, 0, spec.prec);
+        stream->text_len = nul != NULL ? nul - value.s : spec.prec;
+    }
+    else
+    {
+        stream->text_len = strlen(value.s);
+    }
+    if(spec.width > 0)
+    {
+        int pad = spec.width - _stream_text_chars(stream->text, stream->text_len);
+        pad = pad > 0 ? pad : 0;
+        if((spec.flags & PRINTF_FLAG_LEFT) != 0)
+        {
+            stream->pad_after = pad;
+        }
+        else
+        {
+            stream->pad_before = pad;
+        }
+    }
+}
+
+/*
+ * Starts streaming the format string str with the arguments in arg_list
+ * The arguments in arg_list must stay valid until printf_stream_end
+*/
+void printf_stream_init(printf_stream* stream, const char* str, va_list arg_list)
+{
+    stream->str = str;
+    va_copy(stream->args, arg_list);
+    stream->text = NULL;
+    stream->text_len = 0;
+    stream->valid = 0;
+    stream->pad_before = 0;
+    stream->pad_after = 0;
+    stream->num_runs = 0;
+    stream->run = 0;
+    stream->sig_figs = PRINTF_SIG_FIGS;
+}
+
+/*
+ * Writes the next bytes of the message to chunk, filling all size bytes of it unless the message ends first
+ * len is set to the number of bytes written (0 only if the last call filled the chunk exactly)
+ * Returns 1 if more of the message is pending, or 0 once it has all been written
+*/
+int printf_stream_next(printf_stream* stream, char* chunk, int size, int* len)
+{
+    int n = 0;
+    while(n < size)
+    {
+        if(stream->pad_before > 0)
+        {
+            n += _stream_pad(&(stream->pad_before), &(chunk[n]), size - n);
+        }
+        else if(stream->text_len > 0)
+        {
+            n += _stream_text(stream, &(chunk[n]), size - n);
+        }
+        else if(stream->pad_after > 0)
+        {
+            n += _stream_pad(&(stream->pad_after), &(chunk[n]), size - n);
+        }
+        else if(stream->run < stream->num_runs)
+        {
+            n += _stream_field(stream, &(chunk[n]), size - n);
+        }
+        else if(*(stream->str) != 0)
+        {
+            _stream_piece(stream);
+        }
+        else
+        {
+            break;
+        }
+    }
+    *len = n;
+    return stream->pad_before > 0 || stream->text_len > 0 || stream->pad_after > 0 ||
+        stream->run < stream->num_runs || *(stream->str) != 0;
+}
+
+/*
+ * Finishes with the arguments of stream
+*/
+void printf_stream_end(printf_stream* stream)
+{
+    va_end(stream->args);
+}